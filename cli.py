@@ -1,5 +1,5 @@
 #!/usr/bin/env python3
-import os, sys, types, shlex, pathlib, subprocess, contextlib, collections, time, inspect, builtins, itertools
+import os, sys, types, shlex, pathlib, subprocess, contextlib, collections, time, inspect, builtins, itertools, functools, math, wave, array, threading, difflib, random, re
 
 ################################################################ Configuration ################################################################
 
@@ -12,11 +12,94 @@ def ROOT(*subpaths):
 TARGETS = '''
 	Transmitter
 	Receiver
+	Loopback
 '''.split()
 
 TARGET_MCU  = 'atmega328p'
 F_OSC       = 16_000_000 # Also referred to as F_CPU.
-USART0_BAUD = 250_000
+USART0_BAUD = 1_000_000
+
+# How far off the actual USART0 baud rate can be from the desired one; the datasheet
+# recommends staying within 1% for 8-bit data frames with no parity. @/sec 19.8.3/tbl 19-2/(328P).
+USART0_BAUD_TOLERANCE = 0.01
+
+################################ Optical Link ################################
+#
+# These parameters are shared between the firmware (by the meta-preprocessor)
+# and the host tooling (e.g. `render` and `decode`), so both agree on the exact
+# signal that goes through the air. They're defined here rather than in a meta-block
+# of `./src/defs.h` because the host tooling can't evaluate those on its own, and
+# because commands like `benchmark` rebuild the firmware with some of them swapped
+# out; the GPIOs stay in `./src/defs.h` since only the firmware cares about them.
+#
+
+# TODO Look into ATmega328P's clock system.
+F_CLKIO = 16_000_000 - 43_500
+
+# Symbol rate of the optical link; with Manchester coding, the light toggles up to twice per symbol.
+BAUD = 45.45
+
+# Tone pairs of each FSK channel the Transmitter drives with the given timer's OCnA pin.
+# Having a second channel will stripe the data frames across both channels, which `decode`
+# puts back together when given the channel "all"; compression then has to be disabled.
+SIGNALS = (
+	types.SimpleNamespace(channel = 'A', timer = 1, mark = 2295, space = 2125),
+	# types.SimpleNamespace(channel = 'B', timer = 2, mark = 1270, space = 1070),
+)
+
+FRAME = types.SimpleNamespace(
+	data_bits = 8,     # Anywhere from 5 to 8 bits.
+	bit_order = 'msb', # Either 'lsb' or 'msb' first.
+	parity    = None,  # Either None, 'even', or 'odd'.
+	stop_bits = 1,     # Either 1, 1.5, or 2 bits.
+	line_code = 'nrz', # Either 'nrz' (a bit is held for the whole baud period) or 'manchester' (a one goes low then high, a zero goes high then low).
+)
+
+# Whether or not the Transmitter should compress its payloads using a codebook built from `./src/corpus.txt`.
+COMPRESSION = True
+
+# Loop gain of the Receiver's bit synchronizer as 1 / 2**n, which nudges the phase of the
+# baud symbols on every edge within a data frame; None to have the baud symbols free-run
+# from the falling edge of the start bit.
+RECEIVER_PLL_GAIN_SHIFT = 2
+
+# Amount of the most recent events the Receiver keeps in its trace buffer; zero to compile tracing out.
+TRACE_CAPACITY = 64
+
+# Kinds of events the Receiver can trace; the host needs these to make sense of the trace.
+TRACE_EVENTS = (
+	'edge',            # Filtered signal changed to the given level.
+	'frame_start',     # Falling edge of a start bit found.
+	'bit_sampled',     # Baud symbol sampled; data is the symbol's index shifted left by one with the level in the LSb.
+	'frame_end',       # Data frame received; data is the data bits.
+	'start_bit_error', # Start bit wasn't held.
+	'parity_error',    # Parity bit didn't match; data is the data bits so far.
+	'stop_bit_error',  # Stop bit wasn't found; data is the data bits.
+	'usart_flush',     # Finished printing a line to the host.
+	'code_violation',  # Mid-bit transition of a Manchester-coded bit never came; data is the baud symbol's index.
+)
+
+# Moving-median filter the Receiver applies onto its input signal.
+RECEIVER_FILTER = types.SimpleNamespace(
+	sample_period_us = 128, # Must be a multiple of the Receiver's tick of 128us.
+	window           = 32,  # Amount of samples in the window.
+	hysteresis       = 8,   # Amount of samples the majority must exceed by to flip the signal.
+)
+
+# Baud rates and filter settings `benchmark` runs the Loopback at in simavr; everything else is as configured above.
+LOOPBACK_BENCHMARK = (
+	types.SimpleNamespace(baud = 45.45, window = 32, hysteresis = 8),
+	types.SimpleNamespace(baud = 45.45, window = 16, hysteresis = 4),
+	types.SimpleNamespace(baud = 100  , window = 16, hysteresis = 4),
+	types.SimpleNamespace(baud = 300  , window = 8 , hysteresis = 2),
+)
+
+# Amount of bytes the Receiver sets aside for recording or replaying the raw input signal; zero to compile capturing out.
+CAPTURE_CAPACITY = 512
+
+# Byte the host sends the Transmitter to have it send a latency probe; it's reserved, so it can't be sent as payload.
+# The Transmitter sends the same byte as the first data frame of the probe, followed by a data frame of the sequence number.
+PROBE_MARKER = 0x05 # ASCII "enquiry".
 
 COMPILER_SETTINGS = lambda target: (
 	# Miscellaneous flags.
@@ -87,6 +170,236 @@ def round_up(x, n=1):
 def lines_of(string):
 	return [line.strip() for line in string.strip().splitlines()]
 
+################################ Timers ################################
+
+#
+# Clock sources of the timers that can generate a tone on their OCnA pin.
+#
+
+TIMERS = {
+	1 : types.SimpleNamespace(
+		compare_bits = 16, # @/pg 111/sec 15.11.5/(328P).
+		pin          = ('B', 1),
+		dividers     = { # @/pg 110/tbl 15-6/(328P).
+			0b001 : 1,
+			0b010 : 8,
+			0b011 : 64,
+			0b100 : 256,
+			0b101 : 1024,
+		},
+	),
+	2 : types.SimpleNamespace(
+		compare_bits = 8, # @/sec 17.11.4/(328P).
+		pin          = ('B', 3),
+		dividers     = { # @/sec 17.11.2/tbl 17-9/(328P).
+			0b001 : 1,
+			0b010 : 8,
+			0b011 : 32,
+			0b100 : 64,
+			0b101 : 128,
+			0b110 : 256,
+			0b111 : 1024,
+		},
+	),
+}
+
+@functools.cache
+def calculate_timer_configuration(timer, goal_freq):
+
+	best = None
+
+	#
+	# Getting 0Hz output is easy; just use a 0Hz clock source.
+	#
+
+	if goal_freq == 0:
+		best = types.SimpleNamespace(
+			compare_value = 0,
+			clksel        = 0,
+			error         = 0,
+			freq          = 0,
+		)
+
+	#
+	# Otherwise, we'll have to bruteforce some options.
+	#
+
+	else:
+
+		for clksel, divider in TIMERS[timer].dividers.items():
+
+			#
+			# Different clock sources results in different frequencies
+			# that the counter will be incremented at.
+			#
+
+			timer_freq = F_CLKIO / divider
+
+			#
+			# Determine the closest compare value that'll output the desired frequency.
+			# Note that division of two must be done since a compare-match only accounts
+			# for half of a cycle.
+			#
+
+			compare_value = round(timer_freq / goal_freq / 2 - 1)
+
+			#
+			# Determine the actual frequency that'd be generated and the error from it.
+			#
+
+			calculated_freq = timer_freq / (compare_value + 1) / 2
+			error           = abs(calculated_freq / goal_freq - 1)
+
+			#
+			# The compare value has a limited range, so even if the error is
+			# the best so far, we wouldn't be able to actually use the value anyways.
+			#
+
+			if 0 <= compare_value <= 2**TIMERS[timer].compare_bits-1:
+
+				# We found a better configuration that minimizes the error?
+				if best is None or error < best.error:
+					best = types.SimpleNamespace(
+						compare_value = compare_value,
+						clksel        = clksel,
+						error         = error,
+						freq          = calculated_freq,
+					)
+
+	assert best is not None, \
+		f'Timer{timer} cannot generate {goal_freq} Hz.'
+
+	return best
+
+################################ Compression ################################
+
+#
+# The compression scheme is SMAZ-like: byte values below COMPRESSION_FIRST_CODE
+# are sent as-is, while byte values at or above it refer to a substring in a
+# static codebook. A special escape code lets the rare non-ASCII byte through
+# by having it follow the escape code.
+#
+
+COMPRESSION_MAX_ENTRY_LEN = 8
+COMPRESSION_FIRST_CODE    = 128
+COMPRESSION_ESCAPE_CODE   = 255
+
+@functools.cache
+def compression_codebook():
+
+	#
+	# Same restrictions as in `./src/compression.c`; they're checked here too
+	# so that `render` and `decode` don't quietly garble the data.
+	#
+
+	assert FRAME.data_bits == 8, \
+		f'Compression requires frames with 8 data bits; got {FRAME.data_bits}.'
+
+	assert len(SIGNALS) == 1, \
+		f'Compression requires a single FSK channel; got {len(SIGNALS)}.'
+
+	#
+	# Build the codebook from the sample corpus by greedily picking the substring
+	# that'd save the most bytes, then cutting it out of the corpus so substrings
+	# overlapping with it won't be double-counted in the following rounds.
+	#
+
+	corpus   = ROOT('./src/corpus.txt').read_text()
+	segments = [corpus]
+	entries  = []
+
+	assert all(ord(character) < COMPRESSION_FIRST_CODE for character in corpus), \
+		'Compression corpus should only be ASCII.'
+
+	while len(entries) < COMPRESSION_ESCAPE_CODE - COMPRESSION_FIRST_CODE:
+
+		counts = collections.Counter(
+			segment[i : i + length]
+			for segment in segments
+			for length  in range(2, COMPRESSION_MAX_ENTRY_LEN + 1)
+			for i       in range(len(segment) - length + 1)
+		)
+
+		# A substring seen only once is of no use to other text.
+		candidates = [(entry, count) for entry, count in counts.items() if count >= 2 and entry not in entries]
+
+		#
+		# Once the cut-up corpus has nothing repeated left, the rest of the codes are
+		# filled by counting over the whole corpus again, now with the entries that
+		# overlap the ones already picked.
+		#
+
+		if not candidates:
+			if segments == [corpus]:
+				break
+			segments = [corpus]
+			continue
+
+		#
+		# Each occurrence saves all but one byte, but the occurrence that got the substring
+		# into the corpus at all is discounted and repeats are favoured over length; otherwise
+		# a long fragment repeated only because a line of the corpus is (e.g. 'wn fox j')
+		# outranks the short, common ones (e.g. ' th') that unseen text actually shares.
+		#
+
+		entry, count = max(candidates, key=lambda item: ((item[1] - 1)**1.5 * (len(item[0]) - 1), item[0]))
+
+		entries  += [entry]
+		segments  = [piece for segment in segments for piece in segment.split(entry) if piece]
+
+	#
+	# The encoder uses the first match it finds, so longer entries must come first.
+	#
+
+	return tuple(sorted(entries, key=lambda entry: (-len(entry), entry)))
+
+def compress(data):
+
+	codebook = compression_codebook()
+	result   = bytearray()
+
+	while data:
+
+		# Same greedy matching as the Transmitter's `COMPRESSION_encode`.
+		for entry_i, entry in enumerate(codebook):
+			if data.startswith(entry.encode()):
+				result += bytes([COMPRESSION_FIRST_CODE + entry_i])
+				data    = data[len(entry):]
+				break
+		else:
+			if data[0] < COMPRESSION_FIRST_CODE:
+				result += data[:1]
+			else:
+				result += bytes([COMPRESSION_ESCAPE_CODE, data[0]])
+			data = data[1:]
+
+	return bytes(result)
+
+def decompressor():
+
+	# Same as the Receiver's `COMPRESSION_decode`; send codes, get back the decompressed bytes.
+
+	codebook = compression_codebook()
+	escaped  = False
+	result   = b''
+
+	while True:
+		code = yield result
+
+		if escaped:
+			escaped = False
+			result  = bytes([code])
+		elif code == COMPRESSION_ESCAPE_CODE:
+			escaped = True
+			result  = b''
+		elif code >= COMPRESSION_FIRST_CODE:
+			if code - COMPRESSION_FIRST_CODE < len(codebook):
+				result = codebook[code - COMPRESSION_FIRST_CODE].encode()
+			else:
+				result = b'?'
+		else:
+			result = bytes([code])
+
 def execute(default=None, *, bash=None, cmd=None, pwsh=None, keyboard_interrupt_ok=False, error_ok=False):
 
 	#
@@ -149,6 +462,317 @@ def execute(default=None, *, bash=None, cmd=None, pwsh=None, keyboard_interrupt_
 				else:
 					raise err
 
+################################ Optical Link Model ################################
+#
+# Host-side models of the Transmitter and Receiver so captures can be checked
+# and test signals produced without any hardware. These mirror `./src/Transmitter.c`,
+# `./src/frame.c`, and `./src/decoder.c`; if the firmware changes how it frames or
+# decodes data, so should these.
+#
+
+RECEIVER_TICK_US = 128 # Timer0 overflowing at F_CLKIO / 8; see `./src/Receiver.c`.
+
+def frame_symbols(data):
+
+	#
+	# Determine the baud symbols (true for mark) of the data frame and how many baud periods each lasts.
+	#
+
+	data &= (1 << FRAME.data_bits) - 1
+	bits  = [bool((data >> i) & 1) for i in range(FRAME.data_bits)]
+
+	if FRAME.bit_order == 'msb':
+		bits = bits[::-1]
+
+	symbols  = [(False, 1)]              # Start bit.
+	symbols += [(bit, 1) for bit in bits] # Data bits.
+
+	if FRAME.parity is not None: # Parity bit.
+		symbols += [(sum(bits) % 2 != (FRAME.parity == 'odd'), 1)]
+
+	symbols += [(True, FRAME.stop_bits)] # Stop bit(s).
+
+	# With Manchester coding, each bit is split into halves with a transition in the middle;
+	# any stop time beyond the first stop bit is just idling at mark.
+	if FRAME.line_code == 'manchester':
+		symbols = [
+			half
+			for bit, periods in symbols
+			for half in ((not bit, 0.5), (bit, 0.5 + (periods - 1)))
+		]
+
+	return symbols
+
+def transmitter_schedule(message):
+
+	#
+	# Yield the signal of each channel and for how long, just as the Transmitter would for a single pass of the message.
+	#
+
+	payload = compress(message) if COMPRESSION else message
+
+	yield (0.100, ('mark',) * len(SIGNALS))
+
+	for i in range(0, len(payload), len(SIGNALS)):
+
+		# A channel with no data frame to send will just idle with the mark signal.
+		frames = [
+			frame_symbols(payload[i + channel_i]) if i + channel_i < len(payload) else None
+			for channel_i in range(len(SIGNALS))
+		]
+
+		for symbol_i in range(len(frame_symbols(0))):
+			yield (
+				frame_symbols(0)[symbol_i][1] / BAUD,
+				tuple(
+					'mark' if frame is None or frame[symbol_i][0] else 'space'
+					for frame in frames
+				),
+			)
+
+class ToneDiscriminator:
+
+	#
+	# Stand-in for the Receiver's analog front-end that turns the tones of the
+	# given channel into its input signal (high for mark). The frequency is
+	# estimated from the time across the last several zero-crossings; the Schmitt
+	# trigger keeps noise from causing crossings, and interpolating between samples
+	# and averaging over multiple cycles keeps the estimate from being too quantized.
+	#
+	# With more than one channel, the other channels' tones would throw off the
+	# zero-crossings, so the channel's band is picked out with a band-pass filter first.
+	#
+
+	def __init__(self, sample_rate, threshold, channel):
+		self.midpoint    = (channel.mark + channel.space) / 2
+		self.mark_high   = channel.mark > channel.space
+		self.timeout     = 2 * sample_rate / min(channel.mark, channel.space) # No carrier after this many samples.
+		self.sample_rate = sample_rate
+		self.threshold   = threshold
+		self.polarity    = False
+		self.since       = 0
+		self.prev_sample = 0
+		self.periods     = collections.deque([0] * 8, maxlen=8)
+		self.level       = True
+		self.band_pass   = None
+
+		# Second-order band-pass filter as wide as the guard band the channels are kept apart by.
+		if len(SIGNALS) > 1:
+			center         = math.sqrt(channel.mark * channel.space)
+			width          = 3 * max(abs(other.mark - other.space) for other in SIGNALS)
+			w              = 2 * math.pi * center / sample_rate
+			alpha          = math.sin(w) * math.sinh(math.log(2) / 2 * math.log2((center + width / 2) / (center - width / 2)) * w / math.sin(w))
+			self.band_pass = types.SimpleNamespace(
+				b       = (alpha / (1 + alpha), 0, -alpha / (1 + alpha)),
+				a       = (-2 * math.cos(w) / (1 + alpha), (1 - alpha) / (1 + alpha)),
+				history = [0, 0, 0, 0], # Previous two inputs and outputs.
+			)
+
+	def feed(self, sample):
+
+		self.since += 1
+
+		if bp := self.band_pass:
+			x1, x2, y1, y2 = bp.history
+			y              = bp.b[0] * sample + bp.b[1] * x1 + bp.b[2] * x2 - bp.a[0] * y1 - bp.a[1] * y2
+			bp.history     = [sample, x1, y, y1]
+			sample         = y
+
+		if self.polarity and sample < -self.threshold or not self.polarity and sample > self.threshold:
+
+			# Determine how far back between the samples the threshold was actually crossed.
+			crossed          = -self.threshold if self.polarity else self.threshold
+			fraction         = (sample - crossed) / (sample - self.prev_sample) if sample != self.prev_sample else 0
+			self.polarity    = not self.polarity
+			self.periods.append(self.since - fraction)
+			self.since       = fraction
+
+			# Every two half-periods makes up a full cycle.
+			if all(self.periods):
+				freq       = self.sample_rate / sum(self.periods) * len(self.periods) / 2
+				self.level = (freq > self.midpoint) == self.mark_high
+
+		# Line idles with the mark signal when there's no carrier.
+		elif self.since > self.timeout:
+			self.periods.extend([0] * self.periods.maxlen)
+			self.level = True
+
+		self.prev_sample = sample
+
+		return self.level
+
+class ReceiverModel:
+
+	#
+	# The moving-median filter and UART frame state machine the Receiver runs
+	# for each of its channels, ticked every 128us with the level of that
+	# channel's input signal; which channel that is is up to what's fed in.
+	#
+
+	def __init__(self):
+
+		self.time_us = 0
+
+		# Moving-median filter.
+		self.ring_buffer    = [0] * RECEIVER_FILTER.window
+		self.ring_index     = 0
+		self.histogram      = [RECEIVER_FILTER.window, 0]
+		self.prev_signal    = False
+		self.filter_elapsed = 0
+
+		# Frame state machine.
+		self.period_us  = round(1 / BAUD * 1_000_000)
+		self.stop_nth   = 2 + FRAME.data_bits + (FRAME.parity is not None)
+		self.elapsed_us = 0
+		self.baud_nth   = 0
+		self.midpoint   = False
+		self.data       = 0
+		self.parity     = False
+		self.offsets    = []
+
+		if COMPRESSION:
+			self.decompressor = decompressor()
+			next(self.decompressor)
+
+	def tick(self, level):
+
+		# Returns a list of `(kind, time_us, value)` for the data frames that got decoded.
+		events        = []
+		self.time_us += RECEIVER_TICK_US
+
+		#
+		# Get signal with moving-median filter applied.
+		#
+
+		self.filter_elapsed += RECEIVER_TICK_US
+
+		if self.filter_elapsed >= RECEIVER_FILTER.sample_period_us:
+			self.filter_elapsed -= RECEIVER_FILTER.sample_period_us
+
+			self.histogram[self.ring_buffer[self.ring_index]] -= 1
+			self.ring_buffer[self.ring_index]                  = int(level)
+			self.histogram[self.ring_buffer[self.ring_index]] += 1
+			self.ring_index                                    = (self.ring_index + 1) % RECEIVER_FILTER.window
+
+			signal           = self.histogram[0] < self.histogram[1] + (RECEIVER_FILTER.hysteresis if self.prev_signal else -RECEIVER_FILTER.hysteresis)
+			edge             = signal != self.prev_signal
+			self.prev_signal = signal
+
+		else:
+			signal = self.prev_signal
+			edge   = False
+
+		#
+		# Process the UART data frame.
+		#
+
+		self.elapsed_us += RECEIVER_TICK_US
+
+		if FRAME.line_code == 'manchester':
+			return events + self.tick_manchester(signal, edge)
+
+		if not self.baud_nth:
+			if edge and not signal:
+				self.baud_nth   = 1
+				self.midpoint   = False
+				self.elapsed_us = 0
+				self.data       = 0
+				self.parity     = FRAME.parity == 'odd'
+				self.offsets    = []
+
+		# Keep track of how far off each edge within the data frame is from where we expect the baud symbol to begin,
+		# and have the bit synchronizer nudge the phase of the baud symbols.
+		elif edge:
+			if self.elapsed_us < self.period_us // 2:
+				self.offsets += [self.elapsed_us]
+				if RECEIVER_PLL_GAIN_SHIFT is not None:
+					self.elapsed_us -= self.elapsed_us >> RECEIVER_PLL_GAIN_SHIFT
+			else:
+				self.offsets += [self.elapsed_us - self.period_us]
+				if RECEIVER_PLL_GAIN_SHIFT is not None:
+					self.elapsed_us += (self.period_us - self.elapsed_us) >> RECEIVER_PLL_GAIN_SHIFT
+
+		if self.baud_nth:
+
+			if not self.midpoint and self.elapsed_us >= self.period_us // 2:
+
+				self.midpoint = True
+
+				if self.baud_nth == 1:
+					if signal:
+						self.baud_nth  = 0
+						events        += [('start_bit_error', self.time_us, self.offsets)]
+
+				elif self.baud_nth == self.stop_nth:
+					self.baud_nth = 0
+					if signal:
+						events += [('data', self.time_us, (self.data, self.decompressor.send(self.data) if COMPRESSION else bytes([self.data]), self.offsets))]
+					else:
+						events += [('stop_bit_error', self.time_us, self.offsets)]
+
+				elif FRAME.parity is not None and self.baud_nth == self.stop_nth - 1:
+					if signal != self.parity:
+						self.baud_nth  = 0
+						events        += [('parity_error', self.time_us, self.offsets)]
+
+				else:
+					if FRAME.bit_order == 'msb':
+						self.data = ((self.data << 1) | signal) & 0xFF
+					else:
+						self.data = (self.data >> 1) | (signal << (FRAME.data_bits - 1))
+					self.parity ^= signal
+
+			elif self.elapsed_us >= self.period_us:
+				self.baud_nth   += 1
+				self.elapsed_us -= self.period_us
+				self.midpoint    = False
+
+		return events
+
+	def tick_manchester(self, signal, edge):
+
+		# Resynchronizes on the transition in the middle of every bit; transitions at the boundaries of bits are ignored.
+		events = []
+
+		if not self.baud_nth:
+			if edge and not signal:
+				self.baud_nth   = 1
+				self.elapsed_us = 0
+				self.data       = 0
+				self.parity     = FRAME.parity == 'odd'
+				self.offsets    = []
+
+		elif edge and self.elapsed_us >= self.period_us // 4 * 3:
+
+			self.offsets    += [self.elapsed_us - self.period_us]
+			self.elapsed_us  = 0
+			self.baud_nth   += 1
+
+			if self.baud_nth == self.stop_nth:
+				self.baud_nth = 0
+				if signal:
+					events += [('data', self.time_us, (self.data, self.decompressor.send(self.data) if COMPRESSION else bytes([self.data]), self.offsets))]
+				else:
+					events += [('stop_bit_error', self.time_us, self.offsets)]
+
+			elif FRAME.parity is not None and self.baud_nth == self.stop_nth - 1:
+				if signal != self.parity:
+					self.baud_nth  = 0
+					events        += [('parity_error', self.time_us, self.offsets)]
+
+			else:
+				if FRAME.bit_order == 'msb':
+					self.data = ((self.data << 1) | signal) & 0xFF
+				else:
+					self.data = (self.data >> 1) | (signal << (FRAME.data_bits - 1))
+				self.parity ^= signal
+
+		elif self.elapsed_us > self.period_us + self.period_us // 4:
+			self.baud_nth  = 0
+			events        += [('code_violation', self.time_us, self.offsets)]
+
+		return events
+
 ################################################################ CLI Commands ################################################################
 
 cli_commands = {}
@@ -257,9 +881,29 @@ def build():
 			output_dir_path    = str(ROOT('./build')),
 			source_file_paths  = metapreprocessor_file_paths,
 			additional_context = {
-				'F_OSC'       : F_OSC,
-				'USART0_BAUD' : USART0_BAUD,
-				'TARGETS'     : TARGETS,
+				'F_OSC'                         : F_OSC,
+				'F_CLKIO'                       : F_CLKIO,
+				'USART0_BAUD'                   : USART0_BAUD,
+				'USART0_BAUD_TOLERANCE'         : USART0_BAUD_TOLERANCE,
+				'TARGETS'                       : TARGETS,
+				'ROOT'                          : ROOT,
+				'BAUD'                          : BAUD,
+				'SIGNALS'                       : SIGNALS,
+				'FRAME'                         : FRAME,
+				'COMPRESSION'                   : COMPRESSION,
+				'RECEIVER_FILTER'               : RECEIVER_FILTER,
+				'RECEIVER_PLL_GAIN_SHIFT'       : RECEIVER_PLL_GAIN_SHIFT,
+				'TRACE_CAPACITY'                : TRACE_CAPACITY,
+				'TRACE_EVENTS'                  : TRACE_EVENTS,
+				'CAPTURE_CAPACITY'              : CAPTURE_CAPACITY,
+				'PROBE_MARKER'                  : PROBE_MARKER,
+				'TIMERS'                        : TIMERS,
+				'calculate_timer_configuration' : calculate_timer_configuration,
+				'frame_symbols'                 : frame_symbols,
+				'compression_codebook'          : compression_codebook,
+				'COMPRESSION_MAX_ENTRY_LEN'     : COMPRESSION_MAX_ENTRY_LEN,
+				'COMPRESSION_FIRST_CODE'        : COMPRESSION_FIRST_CODE,
+				'COMPRESSION_ESCAPE_CODE'       : COMPRESSION_ESCAPE_CODE,
 			},
 		)
 	except MetaPreprocessor.MetaError as err:
@@ -395,6 +1039,762 @@ def talk():
 		keyboard_interrupt_ok=True,
 	)
 
+def open_serial_port(port_name):
+
+	import serial
+
+	# Opening the port normally pulses DTR which resets the Arduino; we want to talk to the firmware that's already running.
+	port          = serial.Serial()
+	port.baudrate = USART0_BAUD
+	port.timeout  = 1
+	port.dtr      = False
+	port.rts      = False
+
+	# A path to a device (e.g. a pseudo-terminal of a simulated board) is used as-is.
+	if port_name is not None and pathlib.Path(port_name).exists():
+		port.port = port_name
+	else:
+		port.port = get_programmer_port(quiet=True, none_ok=False, preferred_port_name=port_name)
+
+	port.open()
+
+	return port
+
+@CLICommand("Dump the Receiver's trace of events and render it as a timeline.")
+def trace(
+	port_name = ((str, None), 'Port name to find; otherwise, automatically determine it.'),
+):
+
+	#
+	# Request the trace and wait for it; the Receiver could be printing other things at the same time.
+	#
+
+	with open_serial_port(port_name) as port:
+
+		port.reset_input_buffer()
+		port.write(b't')
+
+		lines = None
+
+		while True:
+
+			line = port.readline()
+
+			if not line:
+				sys.exit('# Timed out waiting for the trace.')
+
+			line = line.decode('latin-1').strip()
+
+			if line == 'Trace: disabled.':
+				sys.exit('# The Receiver was built with tracing compiled out; set `TRACE_CAPACITY` to something non-zero.')
+			elif line.startswith('Trace:'):
+				print(f'# {line}')
+				lines = []
+			elif line == 'Trace end.':
+				break
+			elif lines is not None:
+				lines += [line]
+
+	#
+	# Turn the timestamps into microseconds; the tick count is only 16 bits, so it'll have to be unwrapped.
+	#
+
+	us_per_subtick = 8 / F_OSC * 1_000_000 # Timer0 increments at F_CLKIO / 8.
+	events         = []
+	wraps          = 0
+	prev_tick      = None
+
+	for line in lines:
+
+		tick, subtick, channel, event, data = map(int, line.split())
+
+		if prev_tick is not None and tick < prev_tick:
+			wraps += 1
+		prev_tick = tick
+
+		events += [((tick + wraps * 2**16) * RECEIVER_TICK_US + subtick * us_per_subtick, channel, TRACE_EVENTS[event], data)]
+
+	#
+	# Render the timeline along with a lane for the filtered signal of the event's channel;
+	# channels are numbered in the order of the Receiver's inputs.
+	#
+
+	if not events:
+		return
+
+	origin_us = events[0][0]
+	prev_us   = origin_us
+	levels    = collections.defaultdict(lambda: None)
+
+	print(f'# {'Time (ms)' :>10} {'Delta (ms)' :>10}  Channel  Signal  Event')
+
+	for time_us, channel, event, data in events:
+
+		match event:
+			case 'edge'            : levels[channel] = data; detail = 'rising' if data else 'falling'
+			case 'frame_start'     : detail = ''
+			case 'bit_sampled'     : detail = f'symbol #{data >> 1} = {data & 1}'
+			case 'frame_end'       : detail = f'0x{data :02X} {repr(chr(data))}'
+			case 'start_bit_error' : detail = ''
+			case 'parity_error'    : detail = f'0x{data :02X} so far'
+			case 'stop_bit_error'  : detail = f'0x{data :02X}'
+			case 'usart_flush'     : detail = ''
+			case 'code_violation'  : detail = f'symbol #{data}'
+			case unknown           : assert False, unknown
+
+		lane = { None : '?', 0 : '_', 1 : '‾' }[levels[channel]]
+
+		print(f'  {(time_us - origin_us) / 1000 :10.3f} {(time_us - prev_us) / 1000 :+10.3f}  {channel :7}     {lane}     {event :16} {detail}')
+
+		prev_us = time_us
+
+def read_capture(input_file_path):
+
+	#
+	# A capture file is what the Receiver sends: a header with the initial level and byte count,
+	# then the run-length-encoded bytes in hexadecimal, and then a footer.
+	#
+
+	lines = pathlib.Path(input_file_path).read_text().split()
+
+	if len(lines) < 3 or lines[0] != 'Capture:':
+		sys.exit(f'# `{input_file_path}` is not a capture file.')
+
+	initial_level = int(lines[1])
+	runs          = bytes.fromhex(''.join(line for line in lines[3:] if line not in ('Capture', 'end.')))
+
+	if len(runs) != int(lines[2]):
+		sys.exit(f'# `{input_file_path}` should have {lines[2]} bytes of capture; got {len(runs)}.')
+
+	return initial_level, runs
+
+def capture_levels(initial_level, runs):
+
+	#
+	# Expand the runs back into the sampled levels; every byte is that many samples and then a toggle, except for 255.
+	#
+
+	level = initial_level
+
+	for run in runs:
+		yield from [level] * run
+		if run != 255:
+			level = 1 - level
+
+@CLICommand("Record the Receiver's raw input signal into a capture file.")
+def capture(
+	output_file_path = ((str, str(ROOT('./build/signal.capture'))), 'Where to save the capture.'                             ),
+	port_name        = ((str, None)                                , 'Port name to find; otherwise, automatically determine it.'),
+):
+
+	if not CAPTURE_CAPACITY:
+		sys.exit('# Capturing is compiled out; see `CAPTURE_CAPACITY`.')
+
+	with open_serial_port(port_name) as port:
+
+		port.reset_input_buffer()
+		port.write(b'c')
+
+		#
+		# The capture is only sent once the buffer is full, which could take a while if the signal is busy.
+		# It's sent a line at a time between the Receiver's other work, so its status lines could be mixed in.
+		#
+
+		lines = None
+
+		print(f'# Recording {CAPTURE_CAPACITY} bytes of runs...')
+
+		while True:
+
+			line = port.readline().decode('latin-1').strip()
+
+			if line == 'Capture: disabled.':
+				sys.exit('# Capturing is compiled out of the Receiver.')
+			elif line.startswith('Capture:'):
+				lines = [line]
+			elif line == 'Capture end.' and lines is not None:
+				lines += [line]
+				break
+			elif re.fullmatch('[0-9A-F]+', line) and lines is not None:
+				lines += [line]
+
+	pathlib.Path(output_file_path).parent.mkdir(parents=True, exist_ok=True)
+	pathlib.Path(output_file_path).write_text('\n'.join(lines) + '\n')
+
+	initial_level, runs = read_capture(output_file_path)
+	sample_count        = sum(runs)
+
+	print(f'# Saved {sample_count * RECEIVER_FILTER.sample_period_us / 1_000_000 :.3f}s of signal to `{output_file_path}`.')
+
+@CLICommand("Upload a capture file for the Receiver to replay in place of its input pin.")
+def replay(
+	input_file_path = (str          , 'Capture file to replay.'                                  ),
+	port_name       = ((str, None)  , 'Port name to find; otherwise, automatically determine it.'),
+):
+
+	initial_level, runs = read_capture(input_file_path)
+	duration_s          = sum(runs) * RECEIVER_FILTER.sample_period_us / 1_000_000
+
+	if len(runs) > CAPTURE_CAPACITY:
+		sys.exit(f'# Capture of {len(runs)} bytes is bigger than the Receiver can hold ({CAPTURE_CAPACITY} bytes).')
+
+	with open_serial_port(port_name) as port:
+
+		port.reset_input_buffer()
+
+		# The Receiver only checks for commands every so often, so give it time to see the command before the data comes in.
+		port.write(b'r')
+		time.sleep(0.05)
+		port.write(bytes([initial_level]) + len(runs).to_bytes(2, 'little') + runs)
+
+		#
+		# Show what the Receiver decodes out of the replay.
+		#
+
+		deadline = time.time() + duration_s + 2
+
+		while time.time() < deadline:
+
+			line = port.readline().decode('latin-1').rstrip()
+
+			if line:
+				print(line)
+
+			if line == 'Replay end.' or line.startswith('Replay: ') and not line.endswith('bytes.'):
+				break
+
+def percentile(sorted_xs, fraction):
+	return sorted_xs[min(int(fraction * len(sorted_xs)), len(sorted_xs) - 1)]
+
+@CLICommand('Stream known text into the Transmitter and measure what comes out of the Receiver.')
+def soak(
+	transmitter_port = (str              , 'Port name, or path to a device, of the Transmitter.'),
+	receiver_port    = (str              , 'Port name, or path to a device, of the Receiver.'   ),
+	rate             = ((str, '4')       , 'Characters per second to send.'                      ),
+	duration         = ((str, '60')      , 'Seconds to send for.'                                ),
+	seed             = ((str, '0')       , 'Seed for picking the lines of the corpus to send.'   ),
+):
+
+	rate     = float(rate)
+	duration = float(duration)
+	lines    = [line + '\n' for line in ROOT('./src/corpus.txt').read_text().splitlines() if line]
+	rng      = random.Random(int(seed))
+
+	with open_serial_port(transmitter_port) as transmitter, open_serial_port(receiver_port) as receiver:
+
+		#
+		# Have the Receiver only send the characters it got, and get the Transmitter to
+		# stop its demo message by sending it something; once the link goes quiet, we're ready.
+		#
+
+		receiver.write(b'o')
+		transmitter.write(b'\n')
+
+		receiver.timeout = 1.5
+		quiet_deadline   = time.time() + 30
+
+		while receiver.read(1):
+			if time.time() > quiet_deadline:
+				sys.exit('# The Receiver never went quiet; is the Transmitter still sending its demo message?')
+
+		receiver.reset_input_buffer()
+		transmitter.reset_input_buffer()
+		receiver.timeout    = 0.1
+		transmitter.timeout = 0.1
+
+		#
+		# Send the text at a steady pace while timestamping everything the Receiver sends back.
+		#
+
+		sent     = [] # List of `(time, character)`.
+		received = [] # "
+		dropped  = 0
+		done     = threading.Event()
+
+		def send():
+
+			start = time.time()
+			queue = ''
+
+			while time.time() - start < duration:
+
+				if not queue:
+					queue = rng.choice(lines)
+
+				transmitter.write(queue[0].encode())
+				sent.append((time.time(), queue[0]))
+				queue = queue[1:]
+
+				time.sleep(max(start + len(sent) / rate - time.time(), 0))
+
+			done.set()
+
+		sender = threading.Thread(target=send, daemon=True)
+		sender.start()
+
+		start         = time.time()
+		next_report   = start + 10
+		last_activity = start
+
+		while True:
+
+			for byte in receiver.read(256):
+				received.append((time.time(), chr(byte)))
+				last_activity = time.time()
+
+			# The Transmitter tells us when its queue overflows.
+			while transmitter.in_waiting:
+				if (line := transmitter.readline().decode('latin-1').strip()).startswith('Payload:'):
+					dropped = int(line.split()[1])
+
+			if time.time() >= next_report:
+				next_report += 10
+				print(f'# {time.time() - start :6.0f}s : {len(sent)} sent, {len(received)} received.')
+
+			# Once everything is sent, wait for the link to finish sending whatever is still queued up.
+			if done.is_set() and time.time() - max(last_activity, sent[-1][0] if sent else start) > 5:
+				break
+
+		receiver.write(b'O')
+
+	#
+	# Line up what was sent with what was received; the matching characters give the latencies.
+	#
+
+	sent_text     = ''.join(character for _, character in sent    )
+	received_text = ''.join(character for _, character in received)
+	matcher       = difflib.SequenceMatcher(None, sent_text, received_text, autojunk=False)
+	errors        = collections.Counter()
+	latencies     = []
+
+	for tag, i1, i2, j1, j2 in matcher.get_opcodes():
+		match tag:
+			case 'equal':
+				latencies += [received[j][0] - sent[i][0] for i, j in zip(range(i1, i2), range(j1, j2))]
+			case 'replace':
+				errors['substitutions'] += min(i2 - i1, j2 - j1)
+				errors['deletions'    ] += max(i2 - i1 - (j2 - j1), 0)
+				errors['insertions'   ] += max(j2 - j1 - (i2 - i1), 0)
+			case 'delete':
+				errors['deletions'    ] += i2 - i1
+			case 'insert':
+				errors['insertions'   ] += j2 - j1
+			case unknown: assert False, unknown
+
+	elapsed_s = (received[-1][0] if received else time.time()) - start
+	latencies.sort()
+
+	print()
+	print(f'# Characters sent      : {len(sent)}')
+	print(f'# Characters received  : {len(received)}')
+	print(f'# Dropped in the queue : {dropped}')
+	print(f'# Substitutions        : {errors['substitutions']}')
+	print(f'# Deletions            : {errors['deletions']}')
+	print(f'# Insertions           : {errors['insertions']}')
+	print(f'# Character error rate : {sum(errors.values()) / max(len(sent), 1) * 100 :.3f}%')
+	print(f'# Throughput           : {len(latencies) / max(elapsed_s, 1e-9) :.2f} correct characters/s over {elapsed_s :.1f}s.')
+	if latencies:
+		print(f'# Latency              : '
+			f'{percentile(latencies, 0.50) * 1000 :.0f}ms p50, '
+			f'{percentile(latencies, 0.90) * 1000 :.0f}ms p90, '
+			f'{percentile(latencies, 0.99) * 1000 :.0f}ms p99, '
+			f'{latencies[-1] * 1000 :.0f}ms max.'
+		)
+
+@CLICommand('Send latency probes through the link and break down where the time goes.')
+def probe(
+	transmitter_port = (str              , 'Port name, or path to a device, of the Transmitter.'),
+	receiver_port    = (str              , 'Port name, or path to a device, of the Receiver.'   ),
+	count            = ((str, '20')      , 'Amount of probes to send.'                           ),
+	interval         = ((str, '2')       , 'Seconds to wait for each probe.'                     ),
+):
+
+	count    = int(count)
+	interval = float(interval)
+
+	# Time from the probe's first baud symbol going out to the start bit of its sequence number.
+	marker_s = sum(periods for level, periods in frame_symbols(0)) / BAUD
+
+	with open_serial_port(transmitter_port) as transmitter, open_serial_port(receiver_port) as receiver:
+
+		# The probe reports are only sent along with the status lines.
+		receiver.write(b'O')
+
+		receiver.timeout    = 0.01
+		transmitter.timeout = 0.01
+		receiver.reset_input_buffer()
+		transmitter.reset_input_buffer()
+
+		probes = [] # List of `(total_s, tx_queue_s, rx_decode_s, rx_queue_s)`.
+		lost   = 0
+
+		for probe_i in range(count):
+
+			#
+			# The Transmitter tells us which sequence number the probe got and how long it waited;
+			# the Receiver tells us when each channel got it.
+			#
+
+			sent_time = time.time()
+			transmitter.write(bytes([PROBE_MARKER]))
+
+			sequence = None
+			tx_queue = None
+			arrivals = [] # List of `(host_time, sequence, channel, rx_decode_s, rx_queue_s)`.
+
+			while time.time() - sent_time < interval:
+
+				if (line := transmitter.readline().decode('latin-1').strip()).startswith('Probe'):
+					parts    = line.split()
+					sequence = int(parts[1].removesuffix(':'))
+					tx_queue = int(parts[2]) / 1_000_000
+
+				if (line := receiver.readline().decode('latin-1').strip()).startswith('Probe'):
+					parts     = line.split()
+					arrivals += [(time.time(), int(parts[1]), parts[3].removesuffix(':'), int(parts[8]) / 1_000_000, int(parts[11]) / 1_000_000)]
+
+			arrivals = [arrival for arrival in arrivals if sequence is not None and arrival[1] == sequence]
+
+			if not arrivals:
+				lost += 1
+				print(f'# Probe #{probe_i} : lost.')
+				continue
+
+			for host_time, sequence, channel, rx_decode, rx_queue in arrivals:
+				probes += [(host_time - sent_time, tx_queue, rx_decode, rx_queue)]
+				print(
+					f'# Probe #{probe_i} on {channel} : {(host_time - sent_time) * 1000 :.1f}ms total, '
+					f'{tx_queue * 1000 :.1f}ms TX queue, {rx_decode * 1000 :.1f}ms RX decode, {rx_queue * 1000 :.1f}ms RX queue.'
+				)
+
+	#
+	# Whatever isn't accounted for by either end is the USB serial links, the Receiver's filter, and the printing.
+	#
+
+	print()
+	print(f'# Probes sent : {count}')
+	print(f'# Probes lost : {lost}')
+
+	if probes:
+
+		components = {
+			'Total'      : [total for total, *_ in probes],
+			'TX queue'   : [tx_queue for _, tx_queue, _, _ in probes],
+			'Marker'     : [marker_s for _ in probes],
+			'RX decode'  : [rx_decode for _, _, rx_decode, _ in probes],
+			'RX queue'   : [rx_queue for _, _, _, rx_queue in probes],
+			'Unaccounted': [total - tx_queue - marker_s - rx_decode - rx_queue for total, tx_queue, rx_decode, rx_queue in probes],
+		}
+
+		for name, latencies in components.items():
+			latencies = sorted(latencies)
+			print(
+				f'# {name :<11} : '
+				f'{percentile(latencies, 0.50) * 1000 :8.1f}ms p50, '
+				f'{percentile(latencies, 0.90) * 1000 :8.1f}ms p90, '
+				f'{latencies[-1] * 1000 :8.1f}ms max.'
+			)
+
+@CLICommand('Benchmark the Loopback in simavr at each of the settings in `LOOPBACK_BENCHMARK`.')
+def benchmark(
+	duration = ((str, '30')   , 'Seconds of simulated time to run each setting for.'                          ),
+	max_ber  = ((str, '0.001'), 'Highest bit-error rate allowed before exiting with a non-zero exit code.'    ),
+	max_fer  = ((str, '0.01') , 'Highest frame-error rate allowed before exiting with a non-zero exit code.'  ),
+):
+
+	global BAUD, RECEIVER_FILTER
+
+	duration = float(duration)
+	max_ber  = float(max_ber)
+	max_fer  = float(max_fer)
+
+	#
+	# Build the harness that wires the tone back into the input pin.
+	#
+
+	execute(f'''
+		cc
+			-O2
+			-o {ROOT('./build/loopback')}
+			{ROOT('./sim/loopback.c')}
+			-lsimavr
+			-lelf
+	''')
+
+	#
+	# Rebuild and run the Loopback for each setting; the report has to match the one in `./src/Loopback.c`.
+	#
+
+	report_pattern = re.compile(
+		r'Loopback: (?P<elapsed_ms>\d+) ms, (?P<sent>\d+) sent, (?P<good>\d+) good, (?P<corrupted>\d+) corrupted, '
+		r'(?P<framing_errors>\d+) framing errors, (?P<missed>\d+) missed, (?P<spurious>\d+) spurious, '
+		r'(?P<bit_errors>\d+) of (?P<bits>\d+) bits wrong, BER (?P<ber_ppm>\d+) ppm, FER (?P<fer_ppm>\d+) ppm, (?P<throughput>\d+) bit/s\.'
+	)
+
+	original_baud, original_filter = BAUD, RECEIVER_FILTER
+	results                        = [] # List of `(setting, report)`.
+
+	try:
+		for setting in LOOPBACK_BENCHMARK:
+
+			BAUD            = setting.baud
+			RECEIVER_FILTER = types.SimpleNamespace(**{**vars(original_filter), 'window' : setting.window, 'hysteresis' : setting.hysteresis})
+
+			build()
+
+			print(f'# Running at {setting.baud} baud with a window of {setting.window} and hysteresis of {setting.hysteresis}...')
+
+			output = subprocess.run(
+				[ROOT('./build/loopback'), ROOT('./build/Loopback.elf'), str(duration), str(F_OSC)],
+				capture_output = True,
+				text           = True,
+			)
+
+			if output.returncode:
+				sys.exit(f'{output.stderr}\n# The Loopback failed to run at {setting.baud} baud.')
+
+			# Only the last report matters since the counters are never reset; the simulation could've stopped mid-line.
+			reports = [match for line in output.stdout.splitlines() if (match := report_pattern.fullmatch(line.strip()))]
+
+			if not reports:
+				sys.exit(
+					f'{output.stdout[-1000:]}\n'
+					f'# Couldn\'t find a complete report of the Loopback at {setting.baud} baud in the above.'
+				)
+
+			results += [(setting, { name : int(value) for name, value in reports[-1].groupdict().items() })]
+
+	finally:
+		BAUD, RECEIVER_FILTER = original_baud, original_filter
+
+	#
+	# Tabulate; the rates are defined the same way as the Loopback's, just without being rounded to ppm.
+	#
+
+	print()
+	print(f'# {'Baud' :>7} | {'Window' :>6} | {'Hysteresis' :>10} | {'BER' :>10} | {'FER' :>10} | {'Throughput' :>12}')
+
+	failures = []
+
+	for setting, report in results:
+
+		settled = report['good'] + report['corrupted'] + report['framing_errors'] + report['missed'] + report['spurious']
+		ber     = report['bit_errors'] / max(report['bits'], 1)
+		fer     = (settled - report['good']) / max(settled, 1)
+
+		print(
+			f'# {setting.baud :>7} | {setting.window :>6} | {setting.hysteresis :>10} | '
+			f'{ber :>10.2e} | {fer :>10.2e} | {report['throughput'] :>6} bit/s'
+		)
+
+		if ber > max_ber or fer > max_fer or not report['bits']:
+			failures += [setting]
+
+	print()
+	print('# BER is of the data frames that were received; FER also counts the ones that were missed, abandoned, or spurious.')
+
+	if failures:
+		sys.exit(f'# Over the allowed error rates at {', '.join(f'{setting.baud} baud' for setting in failures)}.')
+
+@CLICommand('Render a message into a WAV file of what the Transmitter would output.')
+def render(
+	message          = (str                                       , 'Text to transmit.'          ),
+	output_file_path = ((str, str(ROOT('./build/render.wav'))), 'Where to save the WAV file.'),
+	sample_rate      = ((str, '44100')                            , 'Samples per second.'        ),
+):
+
+	sample_rate = int(sample_rate)
+
+	#
+	# Each channel's timer toggles its output-compare pin on every compare-match, so each
+	# channel is a square wave. When the signal changes, the half-period in progress finishes
+	# first and the new signal takes over from that toggle; a tone starting from nothing has
+	# its counter reset, so its first toggle is a whole half-period of it later.
+	#
+
+	half_periods = [
+		{
+			signal : 1 / calculate_timer_configuration(channel.timer, goal_freq).freq / 2 if goal_freq else None
+			for signal, goal_freq in (('none', 0), ('mark', channel.mark), ('space', channel.space))
+		}
+		for channel in SIGNALS
+	]
+
+	levels    = [1] * len(SIGNALS)
+	countdown = [None] * len(SIGNALS)
+	total_s   = 0
+
+	pathlib.Path(output_file_path).parent.mkdir(parents=True, exist_ok=True)
+
+	with wave.open(str(output_file_path), 'wb') as file:
+
+		file.setnchannels(1)
+		file.setsampwidth(2)
+		file.setframerate(sample_rate)
+
+		for duration_s, signals in transmitter_schedule(message.encode()):
+
+			for channel_i, signal in enumerate(signals):
+				if countdown[channel_i] is None or half_periods[channel_i][signal] is None:
+					countdown[channel_i] = half_periods[channel_i][signal]
+
+			samples = array.array('h')
+
+			for sample_i in range(round((total_s + duration_s) * sample_rate) - round(total_s * sample_rate)):
+
+				for channel_i in range(len(SIGNALS)):
+					if countdown[channel_i] is not None:
+						countdown[channel_i] -= 1 / sample_rate
+						while countdown[channel_i] <= 0:
+							levels   [channel_i]  = -levels[channel_i]
+							countdown[channel_i] += half_periods[channel_i][signals[channel_i]]
+
+				samples.append(round(sum(levels) / len(SIGNALS) * 2**14))
+
+			file.writeframes(samples.tobytes())
+			total_s += duration_s
+
+	print(f'# Rendered {total_s :.3f}s of audio to `{output_file_path}`.')
+
+@CLICommand('Decode a WAV file, a capture file, or a raw file of input signal levels, using the same filter and frame state machine as the Receiver.')
+def decode(
+	input_file_path = (str           , 'WAV file of the tones, a capture file from the Receiver, or a raw file of one byte (0/1) per 128us tick of the input signal.'),
+	threshold       = ((str, '0.05') , 'Fraction of full-scale the tones must swing past to count as a zero-crossing.'           ),
+	channel         = ((str, 'A')    , 'Which FSK channel to pick out of a WAV file, or "all" to put the striped channels back together; captures are always of channel A.'),
+):
+
+	if channel == 'all':
+		signals = SIGNALS
+	elif (signal := next((signal for signal in SIGNALS if signal.channel == channel), None)) is not None:
+		signals = (signal,)
+	else:
+		sys.exit(f'# No channel {repr(channel)}; there are only {', '.join(signal.channel for signal in SIGNALS)}.')
+
+	if len(signals) > 1 and not str(input_file_path).lower().endswith('.wav'):
+		sys.exit('# Only a WAV file can have more than one channel in it.')
+
+	models      = [ReceiverModel() for signal in signals]
+	tally       = collections.Counter()
+	all_offsets = []
+	all_data    = [] # List of `(time_us, channel_i, decoded)`.
+	start       = time.time()
+
+	def report(events, channel_i=0):
+
+		# Each line is tagged with the channel when there are several.
+		tag = f' {signals[channel_i].channel}' if len(signals) > 1 else ''
+
+		for kind, time_us, value in events:
+			match kind:
+
+				case 'data':
+					code, decoded, offsets = value
+					worst  = max(offsets, key=abs, default=0)
+					print(f'[{time_us / 1_000_000 :10.6f}s]{tag} 0x{code :02X} {repr(decoded.decode('latin-1')) :12} worst offset {worst :+6}us')
+					tally['characters'] += len(decoded)
+					tally['frames']     += 1
+					all_offsets.extend(offsets)
+					all_data.append((time_us, channel_i, decoded))
+
+				case 'start_bit_error' | 'parity_error' | 'stop_bit_error' | 'code_violation':
+					print(f'[{time_us / 1_000_000 :10.6f}s]{tag} {kind.replace('_', ' ').capitalize()}.')
+					tally[kind] += 1
+
+				case unknown: assert False, unknown
+
+	#
+	# Feed the tones through the discriminator and then into the Receiver model at every tick.
+	#
+
+	if str(input_file_path).lower().endswith('.wav'):
+
+		with wave.open(str(input_file_path), 'rb') as file:
+
+			sample_rate   = file.getframerate()
+			channel_count = file.getnchannels()
+			sample_width  = file.getsampwidth()
+			full_scale    = 2**(8 * sample_width - 1)
+			typecode      = { 1 : 'B', 2 : 'h', 4 : 'i' }.get(sample_width)
+
+			if typecode is None:
+				sys.exit(f'# Unsupported sample width of {sample_width} bytes.')
+
+			discriminators = [ToneDiscriminator(sample_rate, float(threshold) * full_scale, signal) for signal in signals]
+			tick_s         = RECEIVER_TICK_US / 1_000_000
+			until_tick_s   = tick_s
+
+			while frames := file.readframes(1 << 16):
+
+				samples = array.array(typecode, frames)
+
+				# Only the first channel of the WAV file is used; 8-bit WAV files are unsigned.
+				for sample in itertools.islice(samples, 0, None, channel_count):
+
+					levels = [discriminator.feed(sample - full_scale if sample_width == 1 else sample) for discriminator in discriminators]
+
+					until_tick_s -= 1 / sample_rate
+					while until_tick_s <= 0:
+						until_tick_s += tick_s
+						for channel_i, (model, level) in enumerate(zip(models, levels)):
+							report(model.tick(level), channel_i)
+
+	#
+	# The capture file has the input signal's levels at every sample of the filter, which may span several ticks.
+	#
+
+	elif str(input_file_path).lower().endswith('.capture'):
+		for level in capture_levels(*read_capture(input_file_path)):
+			for tick in range(RECEIVER_FILTER.sample_period_us // RECEIVER_TICK_US):
+				report(models[0].tick(level))
+
+	#
+	# The raw file already has the input signal's levels at every tick.
+	#
+
+	else:
+		with open(input_file_path, 'rb') as file:
+			while chunk := file.read(1 << 16):
+				for byte in chunk:
+					if byte in b'01\x00\x01':
+						report(models[0].tick(byte in b'1\x01'))
+
+	#
+	# Summary.
+	#
+
+	elapsed_s = time.time() - start
+	signal_s  = models[0].time_us / 1_000_000
+
+	#
+	# The Transmitter sends a stripe of data frames on all channels at the same time, so the data
+	# frames decoded within half a data frame of each other are of the same stripe; the message is
+	# then read off stripe by stripe in channel order.
+	#
+
+	if len(signals) > 1:
+
+		frame_us = sum(periods for bit, periods in frame_symbols(0)) / BAUD * 1_000_000
+		stripes  = []
+
+		for time_us, channel_i, decoded in sorted(all_data):
+			if not stripes or time_us - stripes[-1][0] > frame_us / 2:
+				stripes += [(time_us, {})]
+			stripes[-1][1][channel_i] = decoded
+
+		print()
+		print(f'# Recombined : {repr(b''.join(b''.join(stripe[channel_i] for channel_i in sorted(stripe)) for _, stripe in stripes).decode('latin-1'))}')
+
+	print()
+	print(f'# Characters       : {tally['characters']}')
+	print(f'# Data frames      : {tally['frames']}')
+	print(f'# Start bit errors : {tally['start_bit_error']}')
+	print(f'# Parity errors    : {tally['parity_error']}')
+	print(f'# Stop bit errors  : {tally['stop_bit_error']}')
+	print(f'# Code violations  : {tally['code_violation']}')
+	if all_offsets:
+		print(f'# Edge offsets     : {sum(map(abs, all_offsets)) / len(all_offsets) :.0f}us mean, {max(map(abs, all_offsets))}us worst ({len(all_offsets)} edges).')
+	print(f'# Signal duration  : {signal_s :.3f}s decoded in {elapsed_s :.3f}s ({signal_s / max(elapsed_s, 1e-9) :.1f}x real-time).')
+
 @CLICommand(f'Show usage of `{ROOT(os.path.basename(__file__))}`.')
 def help(
 	specifically = ((str, None), 'Name of command to show help info on.'),
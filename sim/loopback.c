@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/avr_ioport.h>
+#include <simavr/avr_uart.h>
+
+//
+// Runs the Loopback firmware in simavr with channel A's output-compare pin wired to
+// the input pin, printing whatever the firmware sends over USART0 to stdout.
+//
+//     loopback <elf> <seconds> <frequency>
+//
+// This is built and run by `./cli.py benchmark`.
+//
+
+static void
+uart_output(struct avr_irq_t* irq, uint32_t value, void* param)
+{
+	putchar((char) value);
+}
+
+extern int
+main(int argc, char** argv)
+{
+	if (argc != 4)
+	{
+		fprintf(stderr, "Usage: %s <elf> <seconds> <frequency>\n", argv[0]);
+		return 1;
+	}
+
+	double   seconds   = strtod (argv[2], NULL);
+	uint32_t frequency = strtoul(argv[3], NULL, 10);
+
+	//
+	// Load the firmware.
+	//
+
+	elf_firmware_t firmware = {0};
+
+	if (elf_read_firmware(argv[1], &firmware))
+	{
+		fprintf(stderr, "Failed to read `%s`.\n", argv[1]);
+		return 1;
+	}
+
+	avr_t* avr = avr_make_mcu_by_name("atmega328p");
+
+	if (!avr)
+	{
+		fprintf(stderr, "simavr doesn't know of the ATmega328P.\n");
+		return 1;
+	}
+
+	avr_init(avr);
+	avr_load_firmware(avr, &firmware);
+	avr->frequency = frequency;
+
+	//
+	// Wire the tone back into the input pin; this must match GPIOS.Loopback in `./src/defs.h`.
+	//
+
+	avr_connect_irq
+	(
+		avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), 1),
+		avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('D'), 6)
+	);
+
+	//
+	// Forward USART0 byte-by-byte rather than letting simavr buffer it into lines of its own.
+	//
+
+	uint32_t flags = 0;
+	avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+	flags &= ~AVR_UART_FLAG_STDIO;
+	avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT), uart_output, NULL);
+
+	//
+	// Run for however long in simulated time.
+	//
+
+	avr_cycle_count_t cycles = (avr_cycle_count_t) (seconds * frequency);
+
+	while (avr->cycle < cycles)
+	{
+		int state = avr_run(avr);
+
+		if (state == cpu_Done || state == cpu_Crashed)
+		{
+			fprintf(stderr, "Simulation stopped early at cycle %llu.\n", (unsigned long long) avr->cycle);
+			return 1;
+		}
+	}
+
+	fflush(stdout);
+	return 0;
+}
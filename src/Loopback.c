@@ -0,0 +1,410 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
+#include <stdarg.h>
+#include <string.h>
+#include "defs.h"
+#include "gpio.c"
+#include "misc.c"
+#include "str.c"
+#include "usart0.c"
+#include "scheduler.c"
+#include "trace.c"
+#include "quality.c"
+#include "decoder.c"
+#include "fsk.c"
+#include "frame.c"
+
+//
+// A self-test of the whole link on a single board: channel A's tone is generated like the
+// Transmitter does, wired straight back into an input pin, and decoded like the Receiver does.
+// A pseudo-random bit sequence is sent nonstop and checked against what comes back, so the
+// bit-error rate, frame-error rate and throughput can be measured for the configured baud rate
+// and filter without needing two boards and something in between them.
+//
+
+#include "loopback.meta"
+/*
+	channel = SIGNALS[0]
+
+	assert any(
+		gpio.kind == 'output_compare' and (gpio.port, gpio.number) == TIMERS[channel.timer].pin
+		for gpio in GPIOS.Loopback
+	), f'Channel {channel.channel} needs P{''.join(map(str, TIMERS[channel.timer].pin))} to be an output-compare GPIO of the Loopback.'
+
+	#
+	# The tone comes back in on a pin-change interrupt. @/sec 12.2/(328P).
+	#
+
+	signal = next(gpio for gpio in GPIOS.Loopback if gpio.name == 'signal')
+	group  = { 'B' : 0, 'C' : 1, 'D' : 2 }[signal.port]
+
+	Meta.define('LOOPBACK_PCIE'      , f'PCIE{group}'                     )
+	Meta.define('LOOPBACK_PCMSK'     , f'PCMSK{group}'                    )
+	Meta.define('LOOPBACK_PCINT'     , f'PCINT{group * 8 + signal.number}')
+	Meta.define('LOOPBACK_PCINT_vect', f'PCINT{group}_vect'               )
+
+	#
+	# The timer toggles its pin every (compare value + 1) * divider clocks, so that's how long each
+	# half of the tone's square wave lasts; the discriminator measures this with Timer0, which counts
+	# every 8 clocks, and decides by which of the two tones the time between edges is closer to.
+	#
+
+	def half_period(goal_freq):
+		best = calculate_timer_configuration(channel.timer, goal_freq)
+		return (best.compare_value + 1) * TIMERS[channel.timer].dividers[best.clksel] / 8
+
+	mark  = half_period(channel.mark )
+	space = half_period(channel.space)
+
+	assert abs(mark - space) >= 4, \
+		f"Channel {channel.channel}'s tones are too close together for the discriminator to tell apart; " \
+		f'the halves of their periods are {mark :.1f} and {space :.1f} Timer0 counts.'
+
+	Meta.define('LOOPBACK_THRESHOLD_SUBTICKS', round((mark + space) / 2))
+	Meta.define('LOOPBACK_MARK_IS_SHORTER'   , int(mark < space)       )
+
+	#
+	# How long a whole data frame lasts.
+	#
+
+	Meta.define('LOOPBACK_FRAME_US', round((2 + FRAME.data_bits + (FRAME.parity is not None) + FRAME.stop_bits - 1) / BAUD * 1_000_000))
+*/
+
+static volatile b8 loopback_level = true; // Set by the discriminator.
+
+ISR(LOOPBACK_PCINT_vect) // @/pg 65/tbl 12-6/(328P).
+{
+	//
+	// Tell the tones apart by how long it's been since the previous edge.
+	//
+
+	static u32 prev_subticks = 0;
+
+	u32 now         = SCHEDULER_subticks();
+	u32 half_period = now - prev_subticks;
+
+	prev_subticks  = now;
+	loopback_level = (half_period < LOOPBACK_THRESHOLD_SUBTICKS) == LOOPBACK_MARK_IS_SHORTER;
+}
+
+//
+// Data frames that went out but haven't been decoded yet, with when their start bit went out,
+// so a decoded data frame can be matched up with the one that was sent around the same time.
+//
+
+static struct
+{
+	u32 subticks;
+	u8  data;
+}                  in_flight[4]     = {0};
+static u8          in_flight_reader = 0;
+static u8          in_flight_writer = 0;
+static struct Decoder decoder       = {0};
+
+static_assert(countof(in_flight) <= 256 && !(countof(in_flight) & (countof(in_flight) - 1)));
+
+//
+// Counters since the beginning of the benchmark; these are never reset.
+//
+
+static struct
+{
+	u32 sent;           // Data frames sent.
+	u32 good;           // Data frames received with all bits correct.
+	u32 corrupted;      // Data frames received but with some bits wrong.
+	u32 framing_errors; // Data frames the decoder abandoned.
+	u32 missed;         // Data frames the decoder never saw.
+	u32 spurious;       // Data frames the decoder found that were never sent.
+	u32 bits;           // Data bits of the data frames that were received.
+	u32 bit_errors;     // Data bits that were wrong.
+	u32 start_subticks; // When the first data frame went out.
+} results = {0};
+
+//
+// The Loopback's work is split into tasks, listed here from highest to lowest priority.
+//
+
+static SchedulerTaskFunction task_transmit, task_sample, task_decode, task_check, task_report, task_commands;
+static const __flash char task_transmit_name[] = "transmit";
+static const __flash char task_sample_name[]   = "sample";
+static const __flash char task_decode_name[]   = "decode";
+static const __flash char task_check_name[]    = "check";
+static const __flash char task_report_name[]   = "report";
+static const __flash char task_commands_name[] = "commands";
+
+static struct SchedulerTask tasks[] =
+{
+	{ .name = task_transmit_name, .function = task_transmit, .period_ticks = 1                                        },
+	{ .name = task_sample_name  , .function = task_sample  , .period_ticks = SCHEDULER_TICKS(MICROSECONDS_PER_SAMPLE) },
+	{ .name = task_decode_name  , .function = task_decode  , .period_ticks = 1                                        },
+	{ .name = task_check_name   , .function = task_check   , .period_ticks = 1                                        },
+	{ .name = task_report_name  , .function = task_report  , .period_ticks = SCHEDULER_TICKS(1000000)                 },
+	{ .name = task_commands_name, .function = task_commands, .period_ticks = SCHEDULER_TICKS(1000)                    },
+};
+
+//////////////////////////////////////////////////////////////// Tasks ////////////////////////////////////////////////////////////////
+
+static void
+task_transmit(u16 delta_ticks)
+{
+	//
+	// Send data frames of PRBS-9 (x^9 + x^5 + 1) back-to-back.
+	//
+
+	static struct FrameEncoder encoder = {0};
+	static u16                 prbs    = 0x1FF;
+	static u8                  data    = 0;
+
+	// Baud symbol is still going?
+	if (!FRAME_advance(&encoder, delta_ticks))
+	{
+		return;
+	}
+
+	// Begin the next data frame.
+	if (!encoder.baud_nth)
+	{
+		data = 0;
+
+		for (u8 i = 0; i < FRAME_DATA_BITS; i += 1)
+		{
+			b8 bit = ((prbs >> 8) ^ (prbs >> 4)) & 1;
+			prbs   = ((prbs << 1) | bit) & 0x1FF;
+			data   = (data << 1) | bit;
+		}
+
+		// The oldest data frame should've been long decoded by now.
+		if ((u8) (in_flight_writer - in_flight_reader) == countof(in_flight))
+		{
+			in_flight_reader += 1;
+			results.missed   += 1;
+		}
+
+		in_flight[in_flight_writer % countof(in_flight)].subticks  = SCHEDULER_subticks();
+		in_flight[in_flight_writer % countof(in_flight)].data      = data;
+		in_flight_writer                                          += 1;
+
+		if (!results.sent)
+		{
+			results.start_subticks = SCHEDULER_subticks();
+		}
+
+		results.sent += 1;
+
+		FRAME_begin(&encoder);
+	}
+
+	set_signal(Channel_A, FRAME_level(&encoder, data) ? Signal_mark : Signal_space);
+}
+
+static void
+task_sample(u16 delta_ticks)
+{
+	// Sampling instants missed while another task ran get the current level, like in the Receiver.
+	static u16 owed_ticks = 0;
+
+	owed_ticks += delta_ticks;
+
+	for (; owed_ticks >= SCHEDULER_TICKS(MICROSECONDS_PER_SAMPLE); owed_ticks -= SCHEDULER_TICKS(MICROSECONDS_PER_SAMPLE))
+	{
+		DECODER_sample(&decoder, 0, loopback_level);
+	}
+}
+
+static void
+task_decode(u16 delta_ticks)
+{
+	DECODER_decode(&decoder, 0, delta_ticks);
+}
+
+static void
+task_check(u16 delta_ticks)
+{
+	//
+	// Match whatever the decoder got with what was sent.
+	//
+
+	enum DataStatus status = decoder.status;
+	decoder.status         = DataStatus_none;
+
+	if (status != DataStatus_none)
+	{
+		//
+		// The start bit of the decoded data frame is found a bit after it went out because of
+		// the filter's delay, but well within half a data frame (subticks are 0.5us); any data
+		// frame that went out before that was never decoded.
+		//
+
+		b8 matched = false;
+
+		while (in_flight_reader != in_flight_writer)
+		{
+			i32 lag = decoder.frame_start_subticks - in_flight[in_flight_reader % countof(in_flight)].subticks;
+
+			if (lag < 0) // Decoded data frame began before anything was sent.
+			{
+				break;
+			}
+			else if (lag < (i32) LOOPBACK_FRAME_US) // Found the data frame it was.
+			{
+				matched = true;
+				break;
+			}
+			else
+			{
+				in_flight_reader += 1;
+				results.missed   += 1;
+			}
+		}
+
+		if (!matched)
+		{
+			results.spurious += 1;
+		}
+		else
+		{
+			u8 sent           = in_flight[in_flight_reader % countof(in_flight)].data;
+			in_flight_reader += 1;
+
+			if (status == DataStatus_success)
+			{
+				u8 wrong            = __builtin_popcount((sent ^ decoder.decoded) & FRAME_DATA_MASK);
+				results.bits       += FRAME_DATA_BITS;
+				results.bit_errors += wrong;
+
+				if (wrong)
+				{
+					results.corrupted += 1;
+				}
+				else
+				{
+					results.good += 1;
+				}
+			}
+			else
+			{
+				results.framing_errors += 1;
+			}
+		}
+	}
+
+	// Data frames that should've been decoded a couple baud periods ago were missed.
+	u32 now = SCHEDULER_subticks();
+
+	while (in_flight_reader != in_flight_writer && now - in_flight[in_flight_reader % countof(in_flight)].subticks > ((u32) LOOPBACK_FRAME_US + BAUD_PERIOD_US * 2) * 2)
+	{
+		in_flight_reader += 1;
+		results.missed   += 1;
+	}
+}
+
+static void
+task_report(u16 delta_ticks)
+{
+	//
+	// Report the results so far every second; the rates are in parts per million.
+	//
+	//     - BER : Wrong bits out of the bits of the data frames that were received.
+	//     - FER : Data frames that didn't come back exactly as sent out of all the data frames
+	//             that were settled one way or another; a spurious data frame counts too since
+	//             it means the decoder got out of sync with the transmitter.
+	//
+	// The elapsed time is since the first data frame went out; it wraps around after ~35 minutes.
+	//
+
+	if (!results.sent)
+	{
+		return;
+	}
+
+	u32 elapsed_ms = (SCHEDULER_subticks() - results.start_subticks) / 2000;
+
+	// Data frames still in flight don't count yet.
+	u32 settled = results.good + results.corrupted + results.framing_errors + results.missed + results.spurious;
+	u32 ber     = results.bits ? (u64) results.bit_errors * 1000000 / results.bits : 0;
+	u32 fer     = settled ? (u64) (settled - results.good) * 1000000 / settled : 0;
+
+	USART0_tx
+	(
+		"Loopback: %lu ms, %lu sent, %lu good, %lu corrupted, %lu framing errors, %lu missed, %lu spurious, "
+		"%lu of %lu bits wrong, BER %lu ppm, FER %lu ppm, %lu bit/s.\n",
+		elapsed_ms,
+		results.sent,
+		results.good,
+		results.corrupted,
+		results.framing_errors,
+		results.missed,
+		results.spurious,
+		results.bit_errors,
+		results.bits,
+		ber,
+		fer,
+		elapsed_ms ? (u32) ((u64) results.good * FRAME_DATA_BITS * 1000 / elapsed_ms) : 0
+	);
+}
+
+static void
+task_commands(u16 delta_ticks)
+{
+	//
+	// Handle commands from the host.
+	//
+
+	char command = {0};
+	if (USART0_rx_char(&command))
+	{
+		switch (command)
+		{
+			case 'q': // Dump the estimated signal quality since the last dump.
+			{
+				QUALITY_report(&decoder.quality, 'A');
+			} break;
+
+			case 't': // Dump the trace of events.
+			{
+				TRACE_dump();
+			} break;
+
+			case 'k': // Dump how the tasks are keeping up.
+			{
+				SCHEDULER_dump(tasks, countof(tasks));
+			} break;
+
+			default: // Unknown command; ignore it.
+			{
+			} break;
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////// Main ////////////////////////////////////////////////////////////////
+
+extern noret void
+main(void)
+{
+	sei(); // Enable interrupts.
+	gpio_init();
+	USART0_init();
+	DECODER_init(&decoder);
+
+	USART0_tx
+	(
+		"Loopback: %lu us baud period, %lu us per sample, window of %u, hysteresis of %u.\n",
+		(u32) BAUD_PERIOD_US,          // Becomes a long at slow enough baud rates.
+		(u32) MICROSECONDS_PER_SAMPLE, // "
+		FILTER_WINDOW,
+		HYSTERESIS
+	);
+
+	// Give the filter time to settle on mark before the first start bit.
+	set_signal(Channel_A, Signal_mark);
+	_delay_ms(100.0);
+
+	// Interrupt on every edge of the tone coming back in. @/sec 12.2/(328P).
+	LOOPBACK_PCMSK |= (1 << LOOPBACK_PCINT);
+	PCICR          |= (1 << LOOPBACK_PCIE);
+
+	SCHEDULER_init();
+	SCHEDULER_run(tasks, countof(tasks));
+}
@@ -8,240 +8,480 @@
 #include "misc.c"
 #include "str.c"
 #include "usart0.c"
+#include "compression.c"
+#include "scheduler.c"
+#include "trace.c"
+#include "capture.c"
+#include "quality.c"
+#include "decoder.c"
 
-extern noret void
-main(void)
+//
+// Each input named "signal_<channel>" is filtered and decoded independently of the others.
+// They're all on the same port, so every channel is sampled at once with a single read.
+//
+
+#include "receiver_channels.meta"
+/*
+	inputs = [gpio for gpio in GPIOS.Receiver if gpio.kind == 'input' and gpio.name.startswith('signal_')]
+
+	assert inputs, \
+		'Receiver needs at least one input named "signal_<channel>".'
+
+	assert len({gpio.port for gpio in inputs}) == 1, \
+		f'Receiver inputs must be on the same port so they can be sampled at once; ' \
+		f'got {', '.join(f'{gpio.name} on P{gpio.port}{gpio.number}' for gpio in inputs)}.'
+
+	Meta.define('RECEIVER_CHANNEL_COUNT', len(inputs)         )
+	Meta.define('RECEIVER_CHANNEL_PINS' , f'PIN{inputs[0].port}') # @/pg 60/sec 13.2.4/(328P).
+
+	with Meta.enter('static const __flash struct { char name; u8 mask; } RECEIVER_CHANNELS[] =', '{', '};', indented=True):
+		for gpio in inputs:
+			Meta.line(f"{{ '{gpio.name.removeprefix('signal_').upper()}', (1 << PIN{gpio.port}{gpio.number}) }},")
+*/
+
+struct ReceiverChannel
 {
-	//////////////////////////////////////////////////////////////// Initialization ////////////////////////////////////////////////////////////////
+	// Filter and UART frame decoder of the input signal.
+	struct Decoder decoder;
 
-	sei(); // Enable interrupts.
-	gpio_init();
-	USART0_init();
+	// Output.
+	char buffer[32];
+	u8   buffer_indexer;
+	u8   heartbeat;
+	u32  quiet_us;
+	b8   probe; // Got the probe marker, so the next data frame is the probe's sequence number.
+	#if COMPRESSION_ENABLED
+		struct CompressionDecoder decompressor;
+	#endif
+
+	//
+	// Counters of how healthy the optical link is; these are never reset, so they'll only wrap around after a very long time.
+	//
 
-	// Make Timer0 count at a rate of F_CLKIO / 8 = ~16MHz / 8 = ~2 MHz. @/pg 87/tbl 14-9/(328P).
-	// We use the overflow to know when a tick has passed, so 256 / (2 MHz) = 128 us.
-	TCCR0B = (0 << CS02) | (1 << CS01) | (0 << CS00);
-	#define MICROSECONDS_PER_TICK 128
+	struct
+	{
+		u32 start_bit_aborts;      // Data frames abandoned because the start bit wasn't held.
+		u32 parity_errors;         // Data frames abandoned because the parity bit didn't match.
+		u32 stop_bit_errors;       // Data frames that ended without a stop bit.
+		u32 code_violations;       // Data frames abandoned because a Manchester-coded baud symbol had no transition in its middle.
+		u32 good_frames;           // Data frames successfully received.
+		u32 characters;            // Characters received, after decompression.
+		u32 characters_per_second; // Characters received in the last second.
+		u32 prev_characters;
+	} stats;
+};
 
-	//////////////////////////////////////////////////////////////// Main ////////////////////////////////////////////////////////////////
+static struct ReceiverChannel channels[RECEIVER_CHANNEL_COUNT] = {0};
+static u32                    uptime_s                         = 0;
+static u32                    skipped_samples                  = 0; // Sampling instants that passed while another task was running.
+
+static void
+print_link_stats(void)
+{
+	USART0_tx("Link stats:\n\tUptime          : %lu s\n\tSkipped samples : %lu\n", uptime_s, skipped_samples);
 
-	for (;;)
+	for (u8 channel_i = 0; channel_i < RECEIVER_CHANNEL_COUNT; channel_i += 1)
 	{
-		//
-		// Roughly determine elapsed time.
-		//
+		struct ReceiverChannel* channel = &channels[channel_i];
 
-		u16 delta_us = {0};
-		{
-			// Timer0's counter overflowed? @/pg 88/sec 14.9.7/(328P).
-			if (TIFR0 & (1 << TOV0))
-			{
-				TIFR0    = (1 << TOV0);           // Clear the flag.
-				delta_us = MICROSECONDS_PER_TICK; // We know at least this amount of time has passed.
-			}
-			else
-			{
-				delta_us = 0; // No tick yet.
-			}
-		}
+		USART0_tx
+		(
+			"\tChannel %c:\n"
+			"\t\tEdges            : %lu\n"
+			"\t\tFilter flips     : %lu\n"
+			"\t\tStart bit aborts : %lu\n"
+			"\t\tParity errors    : %lu\n"
+			"\t\tStop bit errors  : %lu\n"
+			"\t\tCode violations  : %lu\n"
+			"\t\tGood frames      : %lu\n"
+			"\t\tCharacters       : %lu\n"
+			"\t\tCharacters/s     : %lu\n",
+			RECEIVER_CHANNELS[channel_i].name,
+			channel->decoder.edges,
+			channel->decoder.filter_flips,
+			channel->stats.start_bit_aborts,
+			channel->stats.parity_errors,
+			channel->stats.stop_bit_errors,
+			channel->stats.code_violations,
+			channel->stats.good_frames,
+			channel->stats.characters,
+			channel->stats.characters_per_second
+		);
+	}
+}
+
+// When set, only the received characters themselves are sent to the host, without any of the status lines; this is for the host to measure the link with.
+static b8 raw_output = false;
+
+//
+// The Receiver's work is split into tasks, listed here from highest to lowest priority.
+// Sampling and decoding have to keep up with the signal, so they go first; talking with the
+// host can be slow, so it goes last.
+//
+
+static SchedulerTaskFunction task_sample, task_decode, task_output, task_telemetry, task_commands;
+static const __flash char task_sample_name[]    = "sample";
+static const __flash char task_decode_name[]    = "decode";
+static const __flash char task_output_name[]    = "output";
+static const __flash char task_telemetry_name[] = "telemetry";
+static const __flash char task_commands_name[]  = "commands";
+
+static struct SchedulerTask tasks[] =
+{
+	{ .name = task_sample_name   , .function = task_sample   , .period_ticks = SCHEDULER_TICKS(MICROSECONDS_PER_SAMPLE) },
+	{ .name = task_decode_name   , .function = task_decode   , .period_ticks = 1                                        },
+	{ .name = task_output_name   , .function = task_output   , .period_ticks = 1                                        },
+	{ .name = task_telemetry_name, .function = task_telemetry, .period_ticks = SCHEDULER_TICKS(100000)                  },
+	{ .name = task_commands_name , .function = task_commands , .period_ticks = SCHEDULER_TICKS(1000)                    },
+};
+
+//////////////////////////////////////////////////////////////// Tasks ////////////////////////////////////////////////////////////////
+
+static void
+task_sample(u16 delta_ticks)
+{
+	//
+	// If a lower-priority task held things up, the sampling instants that passed are gone; the
+	// current level is filled in for each of them so the filter's window still spans the
+	// amount of time it's meant to, and so a replayed capture keeps its pace.
+	//
+
+	static u16 owed_ticks = 0;
+
+	owed_ticks += delta_ticks;
+
+	u16 samples  = owed_ticks / SCHEDULER_TICKS(MICROSECONDS_PER_SAMPLE);
+	owed_ticks  %= SCHEDULER_TICKS(MICROSECONDS_PER_SAMPLE);
+
+	if (samples > 1)
+	{
+		skipped_samples += samples - 1;
+	}
+
+	//
+	// Get each channel's signal with moving-median filter applied.
+	//
 
-		//
-		// Get signal with moving-median filter applied.
-		//
+	u8 pins = RECEIVER_CHANNEL_PINS;
 
-		b8 signal = {0};
-		b8 edge   = {0};
+	for (u16 sample_i = 0; sample_i < samples; sample_i += 1)
+	{
+		for (u8 channel_i = 0; channel_i < RECEIVER_CHANNEL_COUNT; channel_i += 1)
 		{
-			#define HYSTERESIS              (countof(ring_buffer) / 4)
-			#define MICROSECONDS_PER_SAMPLE 128
-			static u8  ring_buffer[32] = {0};
-			static u8  ring_index      = 0;
-			static i16 histogram[2]    = { countof(ring_buffer), 0 };
-			static b8  prev_signal     = false;
-			static u16 elapsed_us      = 0;
-
-			elapsed_us += delta_us;
-
-			if (elapsed_us >= MICROSECONDS_PER_SAMPLE)
-			{
-				elapsed_us -= MICROSECONDS_PER_SAMPLE;
-
-				// Move the window; update the histogram.
-				histogram[ring_buffer[ring_index]] -= 1;
-				ring_buffer[ring_index]             = GPIO_READ(signal);
-				histogram[ring_buffer[ring_index]] += 1;
-				ring_index                         += 1;
-				ring_index                         %= countof(ring_buffer);
-
-				// Determine the new signal.
-				signal      = histogram[0] < histogram[1] + (prev_signal ? HYSTERESIS : -HYSTERESIS);
-				edge        = signal != prev_signal;
-				prev_signal = signal;
-			}
-			else // No update to the signal.
+			struct ReceiverChannel* channel = &channels[channel_i];
+
+			b8 raw = !!(pins & RECEIVER_CHANNELS[channel_i].mask);
+
+			// Replayed capture takes the place of the first channel's input pin.
+			if (channel_i == 0 && !CAPTURE_replay(&raw))
 			{
-				signal = prev_signal;
-				edge   = false;
+				CAPTURE_record(raw);
 			}
+
+			DECODER_sample(&channel->decoder, channel_i, raw);
 		}
+	}
+}
 
-		//
-		// Process the UART data frame.
-		//
+static void
+task_decode(u16 delta_ticks)
+{
+	//
+	// Process each channel's UART data frame.
+	//
 
-		enum DataStatus
-		{
-			DataStatus_none,
-			DataStatus_start_bit_error,
-			DataStatus_stop_bit_error,
-			DataStatus_success,
-		};
-
-		enum DataStatus data_status = {0};
-		u8              new_data    = 0;
-		{
-			static u16 elapsed_us = 0;
-			static u8  baud_nth   = 0;
-			static b8  midpoint   = false;
-			static u8  data       = 0;
+	b8 any_in_frame = false;
+
+	for (u8 channel_i = 0; channel_i < RECEIVER_CHANNEL_COUNT; channel_i += 1)
+	{
+		struct ReceiverChannel* channel = &channels[channel_i];
+
+		DECODER_decode(&channel->decoder, channel_i, delta_ticks);
+
+		any_in_frame |= !!channel->decoder.baud_nth;
+	}
+
+	GPIO_SET(trigger, any_in_frame);
+}
+
+static void
+task_output(u16 delta_ticks)
+{
+	//
+	// Handle each channel's data.
+	//
 
-			elapsed_us += delta_us;
+	enum PrintReason
+	{
+		PrintReason_none,
+		PrintReason_nothing_new,
+		PrintReason_frame_error,
+		PrintReason_new_data,
+	};
+
+	for (u8 channel_i = 0; channel_i < RECEIVER_CHANNEL_COUNT; channel_i += 1)
+	{
+		struct ReceiverChannel* channel      = &channels[channel_i];
+		enum PrintReason        print_reason = {0};
+		enum DataStatus         data_status  = channel->decoder.status;
+
+		channel->decoder.status  = DataStatus_none;
+		channel->quiet_us       += (u32) delta_ticks * SCHEDULER_MICROSECONDS_PER_TICK;
+
+		// A frame error in between the probe marker and the sequence number loses the probe.
+		if (data_status != DataStatus_none && data_status != DataStatus_success)
+		{
+			channel->probe = false;
+		}
 
-			// Need to find the start bit?
-			if (!baud_nth)
+		switch (data_status)
+		{
+			case DataStatus_none:
 			{
-				// Falling edge found?
-				if (edge && !signal)
+				if (channel->quiet_us >= 1000000)
 				{
-					baud_nth   = 1; // Begin to decode the data frame.
-					midpoint   = false;
-					elapsed_us = 0;
+					channel->quiet_us   = 0;
+					channel->heartbeat += 1;
+					print_reason        = PrintReason_nothing_new;
 				}
-			}
+			} break;
 
-			// Have we began to decode baud symbols?
-			if (baud_nth)
+			case DataStatus_start_bit_error:
 			{
-				// Are we approximately in the midpoint of the baud symbol?
-				if (!midpoint && elapsed_us >= (u16) BAUD_PERIOD_MS * 500)
+				channel->heartbeat              += 1;
+				print_reason                     = PrintReason_frame_error;
+				channel->stats.start_bit_aborts += 1;
+			} break;
+
+			case DataStatus_parity_error:
+			{
+				channel->heartbeat           += 1;
+				print_reason                  = PrintReason_frame_error;
+				channel->stats.parity_errors += 1;
+			} break;
+
+			case DataStatus_stop_bit_error:
+			{
+				channel->heartbeat             += 1;
+				print_reason                    = PrintReason_frame_error;
+				channel->stats.stop_bit_errors += 1;
+			} break;
+
+			case DataStatus_code_violation:
+			{
+				channel->heartbeat             += 1;
+				print_reason                    = PrintReason_frame_error;
+				channel->stats.code_violations += 1;
+			} break;
+
+			case DataStatus_success:
+			{
+				channel->quiet_us           = 0;
+				channel->stats.good_frames += 1;
+
+				//
+				// The latency probe is reported once its sequence number arrives; the delays are of that
+				// last data frame, from when its start bit was found, to when it was decoded, to now.
+				//
+
+				if (channel->probe)
 				{
-					midpoint = true;
+					u32 now = SCHEDULER_subticks();
 
-					// Start bit?
-					if (baud_nth == 1)
+					channel->probe = false;
+
+					if (!raw_output)
 					{
-						// Start bit signal is for some reason high?
-						if (signal)
-						{
-							baud_nth    = 0; // Abort the data frame; might be noise.
-							data_status = DataStatus_start_bit_error;
-						}
+						USART0_tx
+						(
+							"Probe %u on %c: arrived at %lu us, %lu us decode, %lu us queue.\n",
+							channel->decoder.decoded,
+							RECEIVER_CHANNELS[channel_i].name,
+							channel->decoder.frame_start_subticks / 2,
+							(channel->decoder.decoded_subticks - channel->decoder.frame_start_subticks) / 2,
+							(now - channel->decoder.decoded_subticks) / 2
+						);
 					}
-					// Stop bit?
-					else if (baud_nth == 10)
+				}
+				else if (channel->decoder.decoded == PROBE_MARKER)
+				{
+					channel->probe = true;
+				}
+				else
+				{
+					channel->heartbeat += 1;
+					print_reason        = PrintReason_new_data;
+
+					#if COMPRESSION_ENABLED
+						char decompressed[COMPRESSION_MAX_ENTRY_LEN] = {0};
+						u8   decompressed_len                        = COMPRESSION_decode(&channel->decompressor, decompressed, channel->decoder.decoded);
+					#else
+						char decompressed[]  = { channel->decoder.decoded };
+						u8   decompressed_len = 1;
+					#endif
+
+					for (u8 i = 0; i < decompressed_len; i += 1)
 					{
-						// We can stop early so we'll be immediately ready for the next data frame.
-						baud_nth = 0;
+						channel->buffer[channel->buffer_indexer % countof(channel->buffer)]  = decompressed[i];
+						channel->buffer_indexer                                             += 1;
 
-						if (signal)
+						// Characters are only tagged when they could have come from multiple channels.
+						if (raw_output)
 						{
-							data_status = DataStatus_success;
-							new_data    = data;
+							#if RECEIVER_CHANNEL_COUNT > 1
+								USART0_tx("%c", RECEIVER_CHANNELS[channel_i].name);
+							#endif
+							USART0_tx("%c", decompressed[i]);
 						}
-						else
-						{
-							data_status = DataStatus_stop_bit_error;
-						}
-					}
-					// Push the data bit.
-					else
-					{
-						data <<= 1;
-						data |= !!signal;
 					}
+
+					channel->stats.characters += decompressed_len;
 				}
-				// We reach end of the baud symbol?
-				else if (elapsed_us >= (u16) BAUD_PERIOD_MS * 1000)
-				{
-					// Repeat again for the next baud symbol.
-					baud_nth   += 1;
-					elapsed_us -= (u16) BAUD_PERIOD_MS * 1000;
-					midpoint    = false;
-				}
+			} break;
+		}
+
+		if (print_reason && !raw_output)
+		{
+			USART0_tx("%c %u : ", RECEIVER_CHANNELS[channel_i].name, channel->heartbeat);
+			for (int i = 0; i < countof(channel->buffer); i += 1)
+			{
+				char c = channel->buffer[(channel->buffer_indexer + i) % countof(channel->buffer)];
+				USART0_tx("%c", (32 <= c && c <= 126) ? c : '.');
 			}
 
-			GPIO_SET(trigger, !!baud_nth);
+			switch (print_reason)
+			{
+				case PrintReason_none        : break;
+				case PrintReason_nothing_new : USART0_tx(" : Nothing new."); break;
+				case PrintReason_frame_error : USART0_tx(" : Frame error."); break;
+				case PrintReason_new_data    : USART0_tx(" : New data."   ); break;
+			}
+			USART0_tx("\n");
+			TRACE(usart_flush, channel_i, print_reason);
 		}
+	}
+}
 
-		//
-		// Handle the data.
-		//
+static void
+task_telemetry(u16 delta_ticks)
+{
+	//
+	// Keep track of the link-health statistics over time.
+	//
+
+	#define LINK_STATS_PERIOD_S 0 // How often to dump the link-health statistics; zero to only do so when requested.
+
+	static u32 elapsed_us              = 0;
+	static u16 seconds_since_last_dump = 0;
 
+	elapsed_us += (u32) delta_ticks * SCHEDULER_MICROSECONDS_PER_TICK;
+
+	if (elapsed_us >= 1000000)
+	{
+		elapsed_us -= 1000000;
+		uptime_s   += 1;
+
+		for (u8 channel_i = 0; channel_i < RECEIVER_CHANNEL_COUNT; channel_i += 1)
 		{
-			static char buffer[32]     = {0};
-			static u8   buffer_indexer = 0;
-			static u8   heartbeat      = 0;
-			static u32  elapsed_us     = 0;
+			struct ReceiverChannel* channel = &channels[channel_i];
 
-			elapsed_us += delta_us;
+			channel->stats.characters_per_second  = channel->stats.characters - channel->stats.prev_characters;
+			channel->stats.prev_characters        = channel->stats.characters;
+		}
 
-			enum PrintReason
+		#if LINK_STATS_PERIOD_S
+			seconds_since_last_dump += 1;
+			if (seconds_since_last_dump >= LINK_STATS_PERIOD_S)
 			{
-				PrintReason_none,
-				PrintReason_nothing_new,
-				PrintReason_frame_error,
-				PrintReason_new_data,
-			};
+				seconds_since_last_dump = 0;
+				print_link_stats();
+			}
+		#endif
+	}
+}
 
-			enum PrintReason print_reason = {0};
+static void
+task_commands(u16 delta_ticks)
+{
+	// Send whatever the capture has for the host; while a capture is being uploaded, the host's bytes are all for it.
+	if (CAPTURE_poll())
+	{
+		return;
+	}
 
-			switch (data_status)
-			{
-				case DataStatus_none:
-				{
-					if (elapsed_us >= 1000000)
-					{
-						elapsed_us    = 0;
-						heartbeat    += 1;
-						print_reason  = PrintReason_nothing_new;
-					}
-				} break;
+	//
+	// Handle commands from the host.
+	//
 
-				case DataStatus_start_bit_error:
-				case DataStatus_stop_bit_error:
-				{
-					heartbeat    += 1;
-					print_reason  = PrintReason_frame_error;
-				} break;
+	char command = {0};
+	if (USART0_rx_char(&command))
+	{
+		switch (command)
+		{
+			case 's': // Dump the link-health statistics.
+			{
+				print_link_stats();
+			} break;
 
-				case DataStatus_success:
-				{
-					elapsed_us                                = 0;
-					heartbeat                                += 1;
-					print_reason                              = PrintReason_new_data;
-					buffer[buffer_indexer % countof(buffer)]  = new_data;
-					buffer_indexer                           += 1;
-				} break;
-			}
+			case 't': // Dump the trace of events.
+			{
+				TRACE_dump();
+			} break;
 
-			if (print_reason)
+			case 'q': // Dump the estimated signal quality of each channel since the last dump.
 			{
-				USART0_tx("%u : ", heartbeat);
-				for (int i = 0; i < countof(buffer); i += 1)
+				for (u8 channel_i = 0; channel_i < RECEIVER_CHANNEL_COUNT; channel_i += 1)
 				{
-					char c = buffer[(buffer_indexer + i) % countof(buffer)];
-					USART0_tx("%c", (32 <= c && c <= 126) ? c : '.');
+					QUALITY_report(&channels[channel_i].decoder.quality, RECEIVER_CHANNELS[channel_i].name);
 				}
+			} break;
 
-				switch (print_reason)
-				{
-					case PrintReason_none        : break;
-					case PrintReason_nothing_new : USART0_tx(" : Nothing new."); break;
-					case PrintReason_frame_error : USART0_tx(" : Frame error."); break;
-					case PrintReason_new_data    : USART0_tx(" : New data."   ); break;
-				}
-				USART0_tx("\n");
-			}
+			case 'k': // Dump how the tasks are keeping up.
+			{
+				SCHEDULER_dump(tasks, countof(tasks));
+			} break;
+
+			case 'o': // Only send the received characters.
+			{
+				raw_output = true;
+			} break;
+
+			case 'O': // Go back to sending the status lines.
+			{
+				raw_output = false;
+			} break;
+
+			case 'c': // Record the raw input signal; it'll be sent once the capture is full.
+			{
+				CAPTURE_record_begin();
+			} break;
+
+			case 'r': // Receive a capture from the host and then replay it into the decoder.
+			{
+				CAPTURE_replay_begin();
+			} break;
+
+			default: // Unknown command; ignore it.
+			{
+			} break;
 		}
 	}
 }
+
+//////////////////////////////////////////////////////////////// Main ////////////////////////////////////////////////////////////////
+
+extern noret void
+main(void)
+{
+	sei(); // Enable interrupts.
+	gpio_init();
+	USART0_init();
+
+	for (u8 channel_i = 0; channel_i < RECEIVER_CHANNEL_COUNT; channel_i += 1)
+	{
+		DECODER_init(&channels[channel_i].decoder);
+	}
+
+	SCHEDULER_init();
+	SCHEDULER_run(tasks, countof(tasks));
+}
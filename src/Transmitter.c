@@ -8,104 +8,262 @@
 #include "misc.c"
 #include "str.c"
 #include "usart0.c"
+#include "compression.c"
+#include "scheduler.c"
+#include "fsk.c"
+#include "frame.c"
+
+//
+// Bytes from the host are buffered by the USART0 interrupt until task_encode next gets
+// to run; if the host sends faster than the optical link can keep up with, the bytes
+// that don't fit are dropped.
+//
+
+static volatile u8  payload_queue[128] = {0};
+static volatile u8  payload_reader     = 0;
+static volatile u8  payload_writer     = 0;
+static volatile u16 payload_dropped    = 0;
+
+//
+// When the host sends the probe marker, the next message will instead be a latency probe:
+// the probe marker and then the sequence number on every channel. The Transmitter reports
+// how long the probe waited before its first baud symbol went out.
+//
+
+static volatile b8  probe_requested          = false;
+static volatile u32 probe_requested_subticks = 0;
+static u32          probe_queued_subticks    = 0;
+static u32          probe_sent_subticks      = 0;
+static u8           probe_sequence           = 0;
+static b8           probe_sent               = false; // Cleared by the reporter.
+
+static_assert(countof(payload_queue) <= 256 && !(countof(payload_queue) & (countof(payload_queue) - 1)));
+
+ISR(USART_RX_vect) // @/pg 65/tbl 12-6/(328P).
+{
+	u8 byte = UDR0;
+
+	if (byte == PROBE_MARKER)
+	{
+		probe_requested          = true;
+		probe_requested_subticks = SCHEDULER_subticks();
+	}
+	else if ((u8) (payload_writer - payload_reader) < countof(payload_queue))
+	{
+		payload_queue[payload_writer % countof(payload_queue)]  = byte;
+		payload_writer                                         += 1;
+	}
+	else
+	{
+		payload_dropped += 1;
+	}
+}
+
+//
+// The Transmitter's work is split into tasks, listed here from highest to lowest priority.
+// The baud symbols have to go out on time, so they go first.
+//
+
+static SchedulerTaskFunction task_transmit, task_encode, task_report;
+static const __flash char task_transmit_name[] = "transmit";
+static const __flash char task_encode_name[]   = "encode";
+static const __flash char task_report_name[]   = "report";
+
+static struct SchedulerTask tasks[] =
+{
+	{ .name = task_transmit_name, .function = task_transmit, .period_ticks = 1                       },
+	{ .name = task_encode_name  , .function = task_encode  , .period_ticks = 1                       },
+	{ .name = task_report_name  , .function = task_report  , .period_ticks = SCHEDULER_TICKS(100000) },
+};
+
+// Set by the encoder once the transmitter has gone through all of the previous message.
+static struct
+{
+	str message;
+	u16 index;
+	b8  probe; // Message is a latency probe.
+} outgoing = {0};
+
+//////////////////////////////////////////////////////////////// Tasks ////////////////////////////////////////////////////////////////
 
 static void
-set_signal(enum Signal signal)
+task_transmit(u16 delta_ticks)
 {
 	//
-	// In "Clear Timer on Compare Match" mode (CTC), Timer1's counter can be modulated by
-	// OCR1A. That is, the counter goes from zero and up but will reset to zero after a
-	// compare match to OCR1A, thus never becoming greater than OCR1A (but can be equal to it though).
-	// @/pg 97/sec 15.7/(328P).
-	// @/pg 109/tbl 15-5/(328P).
+	// Data frames are striped across the channels and sent simultaneously.
+	// A channel with no data frame to send will just idle with the mark signal.
+	//
+	// The Receiver decodes each channel on its own, so the message is put back together by
+	// taking the data frames that arrived at the same time in channel order, which is what
+	// `cli.py decode` does when given the channel "all". Compression is disabled with more
+	// than one channel, since an escape code and its byte could go out on different channels.
 	//
 
-	#define TIMER1_WAVEFORM_GENERATION_MODE 0b0100
+	static struct FrameEncoder encoder               = {0};
+	static u8                  data  [CHANNEL_COUNT] = {0};
+	static b8                  active[CHANNEL_COUNT] = {0};
 
-	//
-	// Configure the OC1A pin to toggle on each compare-match of OCR1A. @/pg 108/sec 15.11.1/(328P).
-	//
+	// Baud symbol is still going?
+	if (!FRAME_advance(&encoder, delta_ticks))
+	{
+		return;
+	}
+
+	// Begin the next data frame, if there's any.
+	if (!encoder.baud_nth)
+	{
+		if (outgoing.index >= outgoing.message.len)
+		{
+			return;
+		}
 
-	#define TIMER1_OC1A_MODE 0b01
+		for (enum Channel channel = 0; channel < CHANNEL_COUNT; channel += 1)
+		{
+			active[channel] = outgoing.index + channel < outgoing.message.len;
+			data  [channel] = active[channel] ? (outgoing.message.data[outgoing.index + channel] & FRAME_DATA_MASK) : 0;
+		}
 
+		// Timestamp when the probe's first baud symbol goes out.
+		if (outgoing.probe && !outgoing.index)
+		{
+			probe_sent_subticks = SCHEDULER_subticks();
+			probe_sent          = true;
+		}
+
+		outgoing.index += CHANNEL_COUNT;
+		FRAME_begin(&encoder);
+	}
+
+	// Output the baud symbol; nothing to send on a channel means it stays at mark.
+	for (enum Channel channel = 0; channel < CHANNEL_COUNT; channel += 1)
+	{
+		b8 mark = !active[channel] || FRAME_level(&encoder, data[channel]);
+		set_signal(channel, mark ? Signal_mark : Signal_space);
+	}
+}
+
+static void
+task_encode(u16 delta_ticks)
+{
 	//
-	// Configure the registers.
+	// The demo message is repeated until the host sends something; from then
+	// on, the Transmitter only relays whatever the host sends.
 	//
 
-	TCCR1A =
-		(((TIMER1_OC1A_MODE                >> 1) & 1) << COM1A1) |
-		(((TIMER1_OC1A_MODE                >> 0) & 1) << COM1A0) |
-		(((TIMER1_WAVEFORM_GENERATION_MODE >> 1) & 1) << WGM11 ) |
-		(((TIMER1_WAVEFORM_GENERATION_MODE >> 0) & 1) << WGM10 );
+	static b8   relaying           = false;
+	static char payload_buffer[32] = {0};
+
+	// Transmitter isn't done with the previous message yet?
+	if (outgoing.index < outgoing.message.len)
+	{
+		return;
+	}
+
+	str message = {0};
+
+	// Probe goes out as-is without compression so the Receiver can pick it out before decompressing.
+	if (probe_requested)
+	{
+		static char probe_buffer[CHANNEL_COUNT * 2] = {0};
 
-	TCCR1B =
-		(((TIMER1_WAVEFORM_GENERATION_MODE >> 2) & 1) << WGM12) |
-		(((SIGNAL_TABLE[signal].clksel     >> 2) & 1) << CS12 ) |
-		(((SIGNAL_TABLE[signal].clksel     >> 1) & 1) << CS11 ) |
-		(((SIGNAL_TABLE[signal].clksel     >> 0) & 1) << CS10 );
+		cli(); // The timestamp is 32 bits wide and written by the USART0 interrupt.
+		probe_queued_subticks = probe_requested_subticks;
+		probe_requested       = false;
+		sei();
+
+		probe_sequence += 1;
+
+		for (enum Channel channel = 0; channel < CHANNEL_COUNT; channel += 1)
+		{
+			probe_buffer[channel                ] = PROBE_MARKER;
+			probe_buffer[channel + CHANNEL_COUNT] = probe_sequence & FRAME_DATA_MASK;
+		}
+
+		outgoing.message = (str) { probe_buffer, countof(probe_buffer) };
+		outgoing.index   = 0;
+		outgoing.probe   = true;
+		return;
+	}
+
+	if (payload_reader != payload_writer)
+	{
+		relaying = true;
+	}
+
+	if (relaying)
+	{
+		message.data = payload_buffer;
+		while (message.len < countof(payload_buffer) && payload_reader != payload_writer)
+		{
+			message.data[message.len]  = payload_queue[payload_reader % countof(payload_queue)];
+			message.len               += 1;
+			payload_reader            += 1;
+		}
+	}
+	else
+	{
+		message = STR_from_fstr(payload_buffer, countof(payload_buffer), fstr("Doing taxes suck!"));
+	}
+
+	#if COMPRESSION_ENABLED
+		static u8 compressed_buffer[countof(payload_buffer) * 2] = {0}; // Escaping could at worst double the size.
+		message.len  = COMPRESSION_encode(compressed_buffer, countof(compressed_buffer), message);
+		message.data = (char*) compressed_buffer;
+	#endif
 
-	OCR1A = SIGNAL_TABLE[signal].compare_value;
+	outgoing.message = message;
+	outgoing.index   = 0;
+	outgoing.probe   = false;
+}
 
+static void
+task_report(u16 delta_ticks)
+{
 	//
-	// Reset the timer's counter so the frequency transistion is done in a
-	// consistent manner. If we don't do this, the counter might be larger
-	// than the new compare value, to which the next compare-match will not
-	// occur until after the overflow of the counter.
+	// Let the host know it's sending faster than the optical link can keep up with,
+	// and how long the latest latency probe had to wait before it went out.
 	//
 
-	TCNT1 = 0;
+	static u16 prev_dropped = 0;
+
+	cli(); // The counter is 16 bits wide, so the read must not be interrupted.
+	u16 dropped = payload_dropped;
+	sei();
+
+	if (dropped != prev_dropped)
+	{
+		USART0_tx("Payload: %u bytes dropped.\n", dropped);
+		prev_dropped = dropped;
+	}
+
+	if (probe_sent)
+	{
+		probe_sent = false;
+		USART0_tx("Probe %u: %lu us queued.\n", probe_sequence & FRAME_DATA_MASK, (probe_sent_subticks - probe_queued_subticks) / 2);
+	}
 }
 
+//////////////////////////////////////////////////////////////// Main ////////////////////////////////////////////////////////////////
+
 extern noret void
 main(void)
 {
-	//////////////////////////////////////////////////////////////// Initialization ////////////////////////////////////////////////////////////////
-
 	sei(); // Enable interrupts.
 	gpio_init();
 	USART0_init();
 
-	//////////////////////////////////////////////////////////////// Main ////////////////////////////////////////////////////////////////
-
 	#if 1
-		set_signal(Signal_mark); // TODO A way to resynchronize?
-		_delay_ms(100.0);
-
-		str message = str("Doing taxes suck!");
-		for (;;)
+		for (enum Channel channel = 0; channel < CHANNEL_COUNT; channel += 1)
 		{
-			// Data frames.
-			for (u8 i = 0; i < message.len; i += 1)
-			{
-				// Start bit.
-				set_signal(Signal_space);
-				_delay_ms(BAUD_PERIOD_MS);
-
-				// Data bits.
-				for
-				(
-					i8 j = bitsof(message.data[i]) - 1;
-					j >= 0;
-					j -= 1
-				)
-				{
-					if (message.data[i] & (1 << j))
-					{
-						set_signal(Signal_mark);
-					}
-					else
-					{
-						set_signal(Signal_space);
-					}
-
-					_delay_ms(BAUD_PERIOD_MS);
-				}
-
-				// Stop bit.
-				set_signal(Signal_mark);
-				_delay_ms(BAUD_PERIOD_MS);
-			}
+			set_signal(channel, Signal_mark); // TODO A way to resynchronize?
 		}
+		_delay_ms(100.0);
+
+		// Have the host's bytes be queued up as they come in. @/pg 160/sec 19.10.3/(328P).
+		UCSR0B |= (1 << RXCIE0);
+
+		SCHEDULER_init();
+		SCHEDULER_run(tasks, countof(tasks));
 	#else
 		enum Signal curr_signal = Signal_none;
 		for (;;)
@@ -114,7 +272,7 @@ main(void)
 			while (!USART0_rx_char(&input));
 			USART0_tx("%c", input);
 			curr_signal = curr_signal == Signal_mark ? Signal_space : Signal_mark;
-			set_signal(curr_signal);
+			set_signal(Channel_A, curr_signal);
 		}
 	#endif
 }
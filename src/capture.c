@@ -0,0 +1,284 @@
+#include "capture.meta"
+/*
+	assert 0 <= CAPTURE_CAPACITY <= 1024, \
+		f'Capture capacity of {CAPTURE_CAPACITY} bytes is too much for the SRAM.'
+
+	Meta.define('CAPTURE_ENABLED' , int(CAPTURE_CAPACITY != 0))
+	Meta.define('CAPTURE_CAPACITY', CAPTURE_CAPACITY           )
+*/
+
+#if CAPTURE_ENABLED
+
+//
+// The raw input signal is run-length-encoded one byte at a time, starting from a known level:
+//     - 0 to 254 : That many samples, and then the level toggles.
+//     - 255      : That many samples, but the level stays the same.
+// A capture can be recorded from the first channel's input pin, or be uploaded by the host to be replayed in its place.
+//
+// Recording and replaying happen every sample period, so they can't afford to talk to the host;
+// that's left to CAPTURE_poll, which sends a full capture a line at a time so as to not hold up
+// the other tasks for long. An upload comes in far faster than the tasks run, so it's received
+// by the USART0 interrupt instead, and CAPTURE_poll only checks on how far along it is.
+//
+
+#define CAPTURE_UPLOAD_TIMEOUT_US 100000 // How long the host can go quiet in the middle of an upload.
+
+enum CaptureMode
+{
+	CaptureMode_idle,
+	CaptureMode_recording,
+	CaptureMode_full,      // Recorded and being sent.
+	CaptureMode_uploading, // Being received from the host.
+	CaptureMode_replaying,
+	CaptureMode_replayed,  // Replayed and waiting for the host to be told.
+};
+
+static struct
+{
+	enum CaptureMode mode;
+	u8               buffer[CAPTURE_CAPACITY];
+	u16              len;
+	u16              index;
+	b8               initial_level;
+	b8               level;
+	u8               run;
+	b8               toggle;
+	u16              uploaded;          // How much of the upload had been received as of the last poll.
+	u32              uploaded_subticks; // When the upload last made progress.
+} capture = {0};
+
+//
+// The host sends the initial level, the amount of bytes (little-endian), and then the bytes of the capture.
+//
+
+static volatile struct
+{
+	u16 received; // Bytes received so far, the header included.
+	u16 len;
+	u8  initial_level;
+} capture_upload = {0};
+
+ISR(USART_RX_vect) // @/pg 65/tbl 12-6/(328P).
+{
+	u8  byte     = UDR0;
+	u16 received = capture_upload.received;
+
+	if (received == 0)
+	{
+		capture_upload.initial_level = byte;
+	}
+	else if (received == 1)
+	{
+		capture_upload.len = byte;
+	}
+	else if (received == 2)
+	{
+		capture_upload.len |= byte << 8;
+	}
+	else if (received - 3 < countof(capture.buffer)) // Bytes that don't fit are dropped; the length will be rejected anyways.
+	{
+		capture.buffer[received - 3] = byte;
+	}
+
+	capture_upload.received = received + 1;
+}
+
+static void
+CAPTURE_record_begin(void)
+{
+	capture.mode = CaptureMode_recording;
+	capture.len  = 0;
+	capture.run  = 0;
+}
+
+static void
+CAPTURE_record(b8 raw)
+{
+	if (capture.mode == CaptureMode_recording)
+	{
+		// First sample of the capture?
+		if (!capture.len && !capture.run)
+		{
+			capture.initial_level = raw;
+			capture.level         = raw;
+		}
+
+		// Level toggled, so the run is over.
+		if (raw != capture.level)
+		{
+			capture.buffer[capture.len]  = capture.run;
+			capture.len                 += 1;
+			capture.level                = raw;
+			capture.run                  = 1;
+		}
+		// Run got too long, so we'll have to continue it in the next byte.
+		else if (capture.run == 254)
+		{
+			capture.buffer[capture.len]  = 255;
+			capture.len                 += 1;
+			capture.run                  = 0;
+		}
+		else
+		{
+			capture.run += 1;
+		}
+
+		// Capture is full? It'll be sent to the host later.
+		if (capture.len == countof(capture.buffer))
+		{
+			capture.mode  = CaptureMode_full;
+			capture.index = 0;
+		}
+	}
+}
+
+static useret b8        // Replayed a sample?
+CAPTURE_replay(b8* raw)
+{
+	b8 replayed = false;
+
+	if (capture.mode == CaptureMode_replaying)
+	{
+		// Get the next run that has any samples.
+		while (!capture.run && capture.mode == CaptureMode_replaying)
+		{
+			if (capture.toggle)
+			{
+				capture.level  = !capture.level;
+				capture.toggle = false;
+			}
+
+			if (capture.index < capture.len)
+			{
+				capture.run     = capture.buffer[capture.index];
+				capture.toggle  = capture.run != 255;
+				capture.index  += 1;
+			}
+			else // Replay is over; back to the input pin.
+			{
+				capture.mode = CaptureMode_replayed;
+			}
+		}
+
+		if (capture.run)
+		{
+			capture.run -= 1;
+			*raw         = capture.level;
+			replayed     = true;
+		}
+	}
+
+	return replayed;
+}
+
+static useret b8  // Still receiving an upload, so the host's bytes are all for the capture?
+CAPTURE_poll(void)
+{
+	b8 uploading = false;
+
+	switch (capture.mode)
+	{
+		case CaptureMode_full: // Send the header or the next line of the capture.
+		{
+			if (!capture.index)
+			{
+				USART0_tx("Capture: %u %u\n", capture.initial_level, capture.len);
+			}
+
+			for (u8 i = 0; i < 32 && capture.index < capture.len; i += 1)
+			{
+				USART0_tx("%X%X", capture.buffer[capture.index] >> 4, capture.buffer[capture.index] & 0x0F); // Formatter has no field widths, so nibble by nibble.
+				capture.index += 1;
+			}
+
+			USART0_tx("\n");
+
+			if (capture.index == capture.len)
+			{
+				USART0_tx("Capture end.\n");
+				capture.mode = CaptureMode_idle;
+			}
+		} break;
+
+		case CaptureMode_uploading:
+		{
+			cli(); // The counters are 16 bits wide and written by the USART0 interrupt.
+			u16 received = capture_upload.received;
+			u16 len      = capture_upload.len;
+			sei();
+
+			u32 now = SCHEDULER_subticks();
+
+			if (received != capture.uploaded)
+			{
+				capture.uploaded          = received;
+				capture.uploaded_subticks = now;
+			}
+
+			if (received >= 3 && len > countof(capture.buffer))
+			{
+				UCSR0B       &= ~(1 << RXCIE0);
+				capture.mode  = CaptureMode_idle;
+				USART0_tx("Replay: %u bytes is too long; only %u bytes can be held.\n", len, countof(capture.buffer));
+			}
+			else if (received >= 3 && received - 3 == len)
+			{
+				UCSR0B                &= ~(1 << RXCIE0);
+				capture.mode           = CaptureMode_replaying;
+				capture.len            = len;
+				capture.index          = 0;
+				capture.initial_level  = !!capture_upload.initial_level;
+				capture.level          = !!capture_upload.initial_level;
+				capture.run            = 0;
+				capture.toggle         = false;
+				USART0_tx("Replay: %u bytes.\n", len);
+			}
+			else if ((now - capture.uploaded_subticks) / 2 >= CAPTURE_UPLOAD_TIMEOUT_US)
+			{
+				UCSR0B       &= ~(1 << RXCIE0);
+				capture.mode  = CaptureMode_idle;
+				USART0_tx("Replay: timed out.\n");
+			}
+			else
+			{
+				uploading = true;
+			}
+		} break;
+
+		case CaptureMode_replayed:
+		{
+			USART0_tx("Replay end.\n");
+			capture.mode = CaptureMode_idle;
+		} break;
+
+		case CaptureMode_idle:
+		case CaptureMode_recording:
+		case CaptureMode_replaying:
+		{
+		} break;
+	}
+
+	return uploading;
+}
+
+static void
+CAPTURE_replay_begin(void)
+{
+	capture.mode              = CaptureMode_uploading;
+	capture.uploaded          = 0;
+	capture.uploaded_subticks = SCHEDULER_subticks();
+	capture_upload.received   = 0;
+
+	// Have the upload be received as it comes in. @/pg 160/sec 19.10.3/(328P).
+	UCSR0B |= (1 << RXCIE0);
+}
+
+#else
+
+static void CAPTURE_record_begin(void) { USART0_tx("Capture: disabled.\n"); }
+static void CAPTURE_replay_begin(void) { USART0_tx("Replay: disabled.\n"); }
+static void CAPTURE_record(b8 raw) {}
+static useret b8 CAPTURE_poll(void) { return false; }
+static useret b8 CAPTURE_replay(b8* raw) { return false; }
+
+#endif
@@ -0,0 +1,190 @@
+#include "compression.meta"
+/*
+	Meta.define('COMPRESSION_ENABLED', int(COMPRESSION))
+
+	if COMPRESSION:
+
+		#
+		# Codes are a whole byte wide, so every data bit is needed.
+		#
+
+		assert FRAME.data_bits == 8, \
+			f'Compression requires frames with 8 data bits; got {FRAME.data_bits}.'
+
+		#
+		# An escape code and the byte after it have to reach the same decompressor, but the
+		# Transmitter stripes consecutive bytes across its channels and each of the Receiver's
+		# channels decompresses on its own.
+		#
+
+		assert len(SIGNALS) == 1, \
+			f'Compression requires a single FSK channel; got {len(SIGNALS)}.'
+
+		#
+		# Determine how well the corpus compresses with the codebook.
+		#
+
+		entries        = compression_codebook()
+		corpus         = ROOT('./src/corpus.txt').read_text()
+		compressed_len = 0
+		remaining      = corpus
+		while remaining:
+			remaining       = remaining[max((len(entry) for entry in entries if remaining.startswith(entry)), default=1):]
+			compressed_len += 1
+
+		Meta.line(f'// {len(entries)} codebook entries; corpus compresses from {len(corpus)} to {compressed_len} bytes ({compressed_len / len(corpus) * 100 :.1f}%).')
+
+		#
+		# Export the codebook into flash.
+		#
+
+		Meta.define('COMPRESSION_MAX_ENTRY_LEN', COMPRESSION_MAX_ENTRY_LEN)
+		Meta.define('COMPRESSION_FIRST_CODE'   , COMPRESSION_FIRST_CODE   )
+		Meta.define('COMPRESSION_ESCAPE_CODE'  , COMPRESSION_ESCAPE_CODE  )
+
+		def c_string(string):
+			return '"' + ''.join(
+				{ '\n' : '\\n', '\t' : '\\t', '"' : '\\"', '\\' : '\\\\' }.get(character, character)
+				for character in string
+			) + '"'
+
+		with Meta.enter('static const __flash struct { u8 len; char data[COMPRESSION_MAX_ENTRY_LEN]; } COMPRESSION_CODEBOOK[] =', '{', '};', indented=True):
+			for entry in entries:
+				Meta.line(f'{{ {len(entry)}, {c_string(entry)} }},')
+*/
+
+#if COMPRESSION_ENABLED
+
+static useret u16                                   // Amount of bytes written to the destination buffer.
+COMPRESSION_encode(u8* dst, u16 dst_size, str src) // If there's not enough space, the compressed data is truncated.
+{
+	u16 dst_len = 0;
+	u16 src_i   = 0;
+
+	while (src_i < src.len)
+	{
+		//
+		// Find the longest codebook entry matching the upcoming data.
+		//
+
+		u8  code      = 0;
+		u16 match_len = 0;
+
+		for (u8 entry_i = 0; entry_i < countof(COMPRESSION_CODEBOOK); entry_i += 1)
+		{
+			u8 len = COMPRESSION_CODEBOOK[entry_i].len;
+
+			if (len <= src.len - src_i)
+			{
+				u8 char_i = 0;
+				while (char_i < len && COMPRESSION_CODEBOOK[entry_i].data[char_i] == src.data[src_i + char_i])
+				{
+					char_i += 1;
+				}
+
+				// The codebook is sorted from longest to shortest, so the first match is the best.
+				if (char_i == len)
+				{
+					code      = COMPRESSION_FIRST_CODE + entry_i;
+					match_len = len;
+					break;
+				}
+			}
+		}
+
+		//
+		// Emit the code, or the byte itself if there's no match.
+		//
+
+		if (match_len)
+		{
+			if (dst_len + 1 > dst_size)
+			{
+				break;
+			}
+
+			dst[dst_len]  = code;
+			dst_len      += 1;
+			src_i        += match_len;
+		}
+		else if ((u8) src.data[src_i] < COMPRESSION_FIRST_CODE)
+		{
+			if (dst_len + 1 > dst_size)
+			{
+				break;
+			}
+
+			dst[dst_len]  = src.data[src_i];
+			dst_len      += 1;
+			src_i        += 1;
+		}
+		else // Byte collides with the codes, so it'll need to be escaped.
+		{
+			if (dst_len + 2 > dst_size)
+			{
+				break;
+			}
+
+			dst[dst_len + 0]  = COMPRESSION_ESCAPE_CODE;
+			dst[dst_len + 1]  = src.data[src_i];
+			dst_len          += 2;
+			src_i            += 1;
+		}
+	}
+
+	return dst_len;
+}
+
+struct CompressionDecoder
+{
+	b8 escaped;
+};
+
+static useret u8                                                    // Amount of characters written to the destination buffer.
+COMPRESSION_decode(struct CompressionDecoder* decoder, char* dst, u8 code) // Destination buffer must be able to hold COMPRESSION_MAX_ENTRY_LEN characters.
+{
+	u8 len = 0;
+
+	// Previous code was the escape code, so this byte is taken literally.
+	if (decoder->escaped)
+	{
+		decoder->escaped = false;
+		dst[0]           = code;
+		len              = 1;
+	}
+	// The next byte needs to be taken literally.
+	else if (code == COMPRESSION_ESCAPE_CODE)
+	{
+		decoder->escaped = true;
+	}
+	// Expand the codebook entry.
+	else if (code >= COMPRESSION_FIRST_CODE)
+	{
+		u8 entry_i = code - COMPRESSION_FIRST_CODE;
+
+		// Code doesn't correspond to any entry? Likely a corrupted data frame.
+		if (entry_i >= countof(COMPRESSION_CODEBOOK))
+		{
+			dst[0] = '?';
+			len    = 1;
+		}
+		else
+		{
+			len = COMPRESSION_CODEBOOK[entry_i].len;
+			for (u8 i = 0; i < len; i += 1)
+			{
+				dst[i] = COMPRESSION_CODEBOOK[entry_i].data[i];
+			}
+		}
+	}
+	// Plain character.
+	else
+	{
+		dst[0] = code;
+		len    = 1;
+	}
+
+	return len;
+}
+
+#endif
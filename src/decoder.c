@@ -0,0 +1,336 @@
+//
+// Moving-median filter and UART frame decoder of a single input signal. The sampler
+// feeds in the raw level of the input; the decoder then goes through the baud symbols
+// and leaves the outcome of each data frame for whoever is handling the received data.
+//
+
+#include "filter.meta"
+/*
+	assert RECEIVER_FILTER.sample_period_us % 128 == 0, \
+		f"Filter's sample period must be a multiple of the 128us tick; got {RECEIVER_FILTER.sample_period_us}us."
+
+	assert 0 <= RECEIVER_FILTER.hysteresis < RECEIVER_FILTER.window <= 255, \
+		f"Filter's window of {RECEIVER_FILTER.window} samples and hysteresis of {RECEIVER_FILTER.hysteresis} samples is invalid."
+
+	Meta.define('FILTER_WINDOW'          , RECEIVER_FILTER.window          )
+	Meta.define('HYSTERESIS'             , RECEIVER_FILTER.hysteresis      )
+	Meta.define('MICROSECONDS_PER_SAMPLE', RECEIVER_FILTER.sample_period_us)
+*/
+
+#include "pll.meta"
+/*
+	assert RECEIVER_PLL_GAIN_SHIFT is None or 0 <= RECEIVER_PLL_GAIN_SHIFT <= 8, \
+		f"PLL's loop gain must be 1 / 2**n for n from 0 to 8; got n = {RECEIVER_PLL_GAIN_SHIFT}."
+
+	Meta.define('PLL_ENABLED'   , int(RECEIVER_PLL_GAIN_SHIFT is not None))
+	Meta.define('PLL_GAIN_SHIFT', RECEIVER_PLL_GAIN_SHIFT or 0            )
+*/
+
+enum DataStatus
+{
+	DataStatus_none,
+	DataStatus_start_bit_error,
+	DataStatus_parity_error,
+	DataStatus_stop_bit_error,
+	DataStatus_code_violation,
+	DataStatus_success,
+};
+
+struct Decoder
+{
+	// Moving-median filter; set by the sampler.
+	u8  ring_buffer[FILTER_WINDOW];
+	u8  ring_index;
+	i16 histogram[2];
+	b8  prev_raw;
+	b8  signal;
+	b8  edge; // Cleared by the decoder.
+
+	// UART frame decoder; set by the decoder.
+	u16             elapsed_us;
+	u8              baud_nth;
+	b8              midpoint;
+	u8              data;
+	b8              parity;
+	enum DataStatus status;               // Cleared by whoever handles the received data.
+	u8              decoded;
+	u32             frame_start_subticks; // When the start bit of the data frame was found.
+	u32             decoded_subticks;     // When the data frame was decoded.
+
+	// Signal-quality estimator; fed by the decoder.
+	struct QualityEstimator quality;
+
+	// Counters that are never reset.
+	u32 edges;        // Transitions of the raw input signal.
+	u32 filter_flips; // Transitions of the filtered signal.
+};
+
+static void
+DECODER_init(struct Decoder* decoder)
+{
+	// Every filter begins with its window all low.
+	decoder->histogram[0] = FILTER_WINDOW;
+}
+
+static void
+DECODER_sample(struct Decoder* decoder, u8 channel_i, b8 raw) // Channel index is only for tracing.
+{
+	//
+	// Get the signal with moving-median filter applied.
+	//
+
+	if (raw != decoder->prev_raw)
+	{
+		decoder->edges += 1;
+	}
+	decoder->prev_raw = raw;
+
+	// Move the window; update the histogram.
+	decoder->histogram[decoder->ring_buffer[decoder->ring_index]] -= 1;
+	decoder->ring_buffer[decoder->ring_index]                      = raw;
+	decoder->histogram[decoder->ring_buffer[decoder->ring_index]] += 1;
+	decoder->ring_index                                           += 1;
+	decoder->ring_index                                           %= countof(decoder->ring_buffer);
+
+	// Determine the new signal.
+	b8 signal = decoder->histogram[0] < decoder->histogram[1] + (decoder->signal ? HYSTERESIS : -HYSTERESIS);
+
+	if (signal != decoder->signal)
+	{
+		decoder->signal        = signal;
+		decoder->edge          = true;
+		decoder->filter_flips += 1;
+		TRACE(edge, channel_i, signal);
+	}
+}
+
+static void
+DECODER_decode(struct Decoder* decoder, u8 channel_i, u16 delta_ticks) // Channel index is only for tracing.
+{
+	//
+	// Process the UART data frame.
+	//
+
+	b8 signal = decoder->signal;
+	b8 edge   = decoder->edge;
+
+	decoder->edge        = false;
+	decoder->elapsed_us += delta_ticks * SCHEDULER_MICROSECONDS_PER_TICK;
+
+	//
+	// With Manchester coding, every baud symbol has a transition in its middle, and the level
+	// after it is the bit; so rather than sampling at where we think the midpoint is, we just
+	// wait for that transition, which resynchronizes us on every bit. Transitions at the
+	// boundaries between baud symbols come only half a baud period after the previous
+	// mid-symbol transition, so they're ignored; if no mid-symbol transition came at all,
+	// then the data frame is abandoned.
+	//
+
+	#if FRAME_MANCHESTER
+
+	// Need to find the start bit?
+	if (!decoder->baud_nth)
+	{
+		// Falling edge in the middle of the start bit found?
+		if (edge && !signal)
+		{
+			decoder->baud_nth             = FRAME_START_NTH; // Begin to decode the data frame.
+			decoder->midpoint             = false;
+			decoder->elapsed_us           = 0;
+			decoder->data                 = 0;
+			decoder->parity               = FRAME_PARITY_ODD;
+			decoder->frame_start_subticks = SCHEDULER_subticks();
+			TRACE(frame_start, channel_i, 0);
+		}
+	}
+	// Transition in the middle of the next baud symbol?
+	else if (edge && decoder->elapsed_us >= BAUD_PERIOD_US / 4 * 3)
+	{
+		QUALITY_edge(&decoder->quality, decoder->elapsed_us - BAUD_PERIOD_US);
+
+		decoder->baud_nth   += 1;
+		decoder->midpoint    = false;
+		decoder->elapsed_us  = 0;
+		TRACE(bit_sampled, channel_i, (decoder->baud_nth << 1) | signal);
+
+		// Stop bit?
+		if (decoder->baud_nth == FRAME_STOP_NTH)
+		{
+			decoder->baud_nth = 0;
+
+			if (signal)
+			{
+				decoder->status           = DataStatus_success;
+				decoder->decoded          = decoder->data;
+				decoder->decoded_subticks = SCHEDULER_subticks();
+				TRACE(frame_end, channel_i, decoder->data);
+			}
+			else
+			{
+				decoder->status = DataStatus_stop_bit_error;
+				TRACE(stop_bit_error, channel_i, decoder->data);
+			}
+		}
+		// Parity bit doesn't match up with the data bits received so far?
+		#if FRAME_PARITY_ENABLED
+		else if (decoder->baud_nth == FRAME_PARITY_NTH)
+		{
+			if (signal != decoder->parity)
+			{
+				decoder->baud_nth = 0; // Abort the data frame.
+				decoder->status   = DataStatus_parity_error;
+				TRACE(parity_error, channel_i, decoder->data);
+			}
+		}
+		#endif
+		// Push the data bit.
+		else
+		{
+			#if FRAME_MSB_FIRST
+				decoder->data <<= 1;
+				decoder->data  |= !!signal;
+			#else
+				decoder->data >>= 1;
+				decoder->data  |= !!signal << (FRAME_DATA_BITS - 1);
+			#endif
+
+			decoder->parity ^= !!signal;
+		}
+	}
+	// Mid-symbol transition never came?
+	else if (decoder->elapsed_us > BAUD_PERIOD_US + BAUD_PERIOD_US / 4)
+	{
+		TRACE(code_violation, channel_i, decoder->baud_nth);
+		decoder->baud_nth = 0; // Abort the data frame.
+		decoder->status   = DataStatus_code_violation;
+	}
+
+	// The filter's window is only settled on the bit halfway through the second half of the baud symbol.
+	if (decoder->baud_nth && !decoder->midpoint && decoder->elapsed_us >= BAUD_PERIOD_US / 4)
+	{
+		decoder->midpoint = true;
+		QUALITY_bit(&decoder->quality, decoder->histogram[signal], decoder->histogram[!signal]);
+	}
+
+	#else
+
+	// Need to find the start bit?
+	if (!decoder->baud_nth)
+	{
+		// Falling edge found?
+		if (edge && !signal)
+		{
+			decoder->baud_nth             = FRAME_START_NTH; // Begin to decode the data frame.
+			decoder->midpoint             = false;
+			decoder->elapsed_us           = 0;
+			decoder->data                 = 0;
+			decoder->parity               = FRAME_PARITY_ODD;
+			decoder->frame_start_subticks = SCHEDULER_subticks();
+			TRACE(frame_start, channel_i, 0);
+		}
+	}
+
+	//
+	// Within the data frame, the edges should line up with where we expect the baud symbols
+	// to begin. If an edge comes late, then our clock is ahead, so we pull back; if an edge
+	// comes early, then our clock is behind, so we push ahead. Only a fraction of the phase
+	// error is corrected each time so a single noisy edge won't throw us off too much. The
+	// phase error is also how we measure the jitter of the edges.
+	//
+
+	else if (edge)
+	{
+		if (decoder->elapsed_us < BAUD_PERIOD_US / 2) // Edge came late.
+		{
+			QUALITY_edge(&decoder->quality, decoder->elapsed_us);
+			#if PLL_ENABLED
+				decoder->elapsed_us -= decoder->elapsed_us >> PLL_GAIN_SHIFT;
+			#endif
+		}
+		else // Edge came early.
+		{
+			QUALITY_edge(&decoder->quality, decoder->elapsed_us - BAUD_PERIOD_US);
+			#if PLL_ENABLED
+				decoder->elapsed_us += (BAUD_PERIOD_US - decoder->elapsed_us) >> PLL_GAIN_SHIFT;
+			#endif
+		}
+	}
+
+	// Have we began to decode baud symbols?
+	if (decoder->baud_nth)
+	{
+		// Are we approximately in the midpoint of the baud symbol?
+		if (!decoder->midpoint && decoder->elapsed_us >= BAUD_PERIOD_US / 2)
+		{
+			decoder->midpoint = true;
+			TRACE(bit_sampled, channel_i, (decoder->baud_nth << 1) | signal);
+			QUALITY_bit(&decoder->quality, decoder->histogram[signal], decoder->histogram[!signal]);
+
+			// Start bit?
+			if (decoder->baud_nth == FRAME_START_NTH)
+			{
+				// Start bit signal is for some reason high?
+				if (signal)
+				{
+					decoder->baud_nth = 0; // Abort the data frame; might be noise.
+					decoder->status   = DataStatus_start_bit_error;
+					TRACE(start_bit_error, channel_i, 0);
+				}
+			}
+			// Stop bit?
+			else if (decoder->baud_nth == FRAME_STOP_NTH)
+			{
+				// We can stop early so we'll be immediately ready for the next data frame.
+				decoder->baud_nth = 0;
+
+				if (signal)
+				{
+					decoder->status           = DataStatus_success;
+					decoder->decoded          = decoder->data;
+					decoder->decoded_subticks = SCHEDULER_subticks();
+					TRACE(frame_end, channel_i, decoder->data);
+				}
+				else
+				{
+					decoder->status = DataStatus_stop_bit_error;
+					TRACE(stop_bit_error, channel_i, decoder->data);
+				}
+			}
+			// Parity bit doesn't match up with the data bits received so far?
+			#if FRAME_PARITY_ENABLED
+			else if (decoder->baud_nth == FRAME_PARITY_NTH)
+			{
+				if (signal != decoder->parity)
+				{
+					decoder->baud_nth = 0; // Abort the data frame.
+					decoder->status   = DataStatus_parity_error;
+					TRACE(parity_error, channel_i, decoder->data);
+				}
+			}
+			#endif
+			// Push the data bit.
+			else
+			{
+				#if FRAME_MSB_FIRST
+					decoder->data <<= 1;
+					decoder->data  |= !!signal;
+				#else
+					decoder->data >>= 1;
+					decoder->data  |= !!signal << (FRAME_DATA_BITS - 1);
+				#endif
+
+				decoder->parity ^= !!signal;
+			}
+		}
+		// We reach end of the baud symbol?
+		else if (decoder->elapsed_us >= BAUD_PERIOD_US)
+		{
+			// Repeat again for the next baud symbol.
+			decoder->baud_nth   += 1;
+			decoder->elapsed_us -= BAUD_PERIOD_US;
+			decoder->midpoint    = false;
+		}
+	}
+
+	#endif
+}
@@ -1,30 +1,29 @@
 //////////////////////////////////////////////////////////////// Configurations ////////////////////////////////////////////////////////////////
 
-/* #meta GPIOS, SIGNALS, F_CLKIO
+/* #meta GPIOS
 /*
-	# TODO Look into ATmega328P's clock system.
-	F_CLKIO = 16_000_000 - 43_500
-
 	GPIOS = Meta.Obj( # TODO Pull-ups?
 		Transmitter = Meta.Table(
+			('name'         , 'kind'          , 'port', 'number'),
+			('builtin_led'  , 'output'        , 'B'   , 5       ),
+			('trigger'      , 'output'        , 'D'   , 4       ),
+			('transmitter'  , 'output_compare', 'B'   , 1       ),
+			('transmitter_b', 'output_compare', 'B'   , 3       ),
+		),
+		Receiver = Meta.Table( # Inputs named "signal_<channel>" are each decoded independently; they must all be on the same port.
 			('name'       , 'kind'          , 'port', 'number'),
 			('builtin_led', 'output'        , 'B'   , 5       ),
-			('trigger'    , 'output'        , 'D'   , 4       ),
-			('transmitter', 'output_compare', 'B'   , 1       ),
+			('signal_a'   , 'input'         , 'D'   , 6       ),
+			# ('signal_b'   , 'input'         , 'D'   , 7       ),
+			('trigger'    , 'output'        , 'B'   , 2       ),
 		),
-		Receiver = Meta.Table(
+		Loopback = Meta.Table( # Channel A's output-compare pin is wired to "signal" (as sim/loopback.c does in simavr).
 			('name'       , 'kind'          , 'port', 'number'),
 			('builtin_led', 'output'        , 'B'   , 5       ),
+			('transmitter', 'output_compare', 'B'   , 1       ),
 			('signal'     , 'input'         , 'D'   , 6       ),
-			('trigger'    , 'output'        , 'B'   , 2       ),
 		),
 	)
-
-	SIGNALS = {
-		'none'  : 0,
-		'mark'  : 2295,
-		'space' : 2125,
-	}
 */
 
 //////////////////////////////////////////////////////////////// Primitives ////////////////////////////////////////////////////////////////
@@ -66,14 +65,26 @@
 		''')
 */
 
-// TODO Flash strings.
-#define str(...) ((str) { ("" __VA_ARGS__), sizeof("" __VA_ARGS__) })
+#define str(...) ((str) { ("" __VA_ARGS__), sizeof("" __VA_ARGS__) - 1 })
 typedef struct
 {
 	char* data;
 	u16   len;
 } str;
 
+//
+// String literals are normally copied into SRAM at startup; these stay in flash instead
+// and are read from there directly. @/pg 17/sec 8.2/(328P).
+//
+
+#define FSTR(...) (__extension__ ({ static const __flash char _fstr[] = ("" __VA_ARGS__); &_fstr[0]; }))
+#define fstr(...) ((fstr) { FSTR(__VA_ARGS__), sizeof("" __VA_ARGS__) - 1 })
+typedef struct
+{
+	const __flash char* data;
+	u16                 len;
+} fstr;
+
 //////////////////////////////////////////////////////////////// str.c ////////////////////////////////////////////////////////////////
 
 enum StrFmtBuilderCallbackResult
@@ -95,92 +106,129 @@ enum StrShowIntStyle
 
 //////////////////////////////////////////////////////////////// Misc. ////////////////////////////////////////////////////////////////
 
-#define BAUD_PERIOD_MS (1.0 / 45.45 * 1000.0) // Period of baud rate for 45.45 b/s.
-
-#include "timer_configurer.meta"
+#include "frame.meta"
 /*
 	#
-	# Create enumeration of signals that could be sent.
+	# Period of the baud rate; the integer microseconds is what the Receiver keeps time with.
+	#
+
+	Meta.define('BAUD_PERIOD_MS', 1 / BAUD * 1000           )
+	Meta.define('BAUD_PERIOD_US', round(1 / BAUD * 1_000_000))
+
+	#
+	# Ensure the UART frame format is sensible.
+	#
+
+	assert FRAME.data_bits in (5, 6, 7, 8), \
+		f'Frame must have 5 to 8 data bits; got {FRAME.data_bits}.'
+
+	assert FRAME.bit_order in ('lsb', 'msb'), \
+		f'Unknown bit order for frame: {repr(FRAME.bit_order)}.'
+
+	assert FRAME.parity in (None, 'even', 'odd'), \
+		f'Unknown parity for frame: {repr(FRAME.parity)}.'
+
+	assert FRAME.stop_bits in (1, 1.5, 2), \
+		f'Frame must have 1, 1.5, or 2 stop bits; got {FRAME.stop_bits}.'
+
+	assert FRAME.line_code in ('nrz', 'manchester'), \
+		f'Unknown line code for frame: {repr(FRAME.line_code)}.'
+
+	#
+	# Export the format so both the transmitter and receiver can be specialized at compile-time.
 	#
 
-	Meta.enums('Signal', None, SIGNALS.keys())
+	Meta.define('FRAME_DATA_BITS'     , FRAME.data_bits              )
+	Meta.define('FRAME_DATA_MASK'     , (1 << FRAME.data_bits) - 1   )
+	Meta.define('FRAME_MSB_FIRST'     , int(FRAME.bit_order == 'msb'))
+	Meta.define('FRAME_PARITY_ENABLED', int(FRAME.parity is not None))
+	Meta.define('FRAME_PARITY_ODD'    , int(FRAME.parity == 'odd')   )
+	Meta.define('FRAME_STOP_BITS'     , float(FRAME.stop_bits)       )
+	Meta.define('FRAME_MANCHESTER'    , int(FRAME.line_code == 'manchester'))
 
 	#
-	# Calculate look-up table for configuring the timer to output the desired frequency.
+	# Determine which baud symbol of the data frame each field lands on (one-indexed).
+	# The receiver only needs to verify the first stop bit; the remaining stop time is
+	# indistinguishable from the line idling.
 	#
 
-	with Meta.enter('static struct { u8 clksel; u16 compare_value; } SIGNAL_TABLE[] =', '{', '};', indented=True):
+	nth = 1
+	Meta.define('FRAME_START_NTH', nth)
+	nth += 1
 
-		for signal, goal_freq in SIGNALS.items():
+	Meta.define('FRAME_DATA_NTH_FIRST', nth)
+	nth += FRAME.data_bits
+	Meta.define('FRAME_DATA_NTH_LAST', nth - 1)
 
-			best = None
+	if FRAME.parity is not None:
+		Meta.define('FRAME_PARITY_NTH', nth)
+		nth += 1
 
-			#
-			# Getting 0Hz output is easy; just use a 0Hz clock source.
-			#
+	Meta.define('FRAME_STOP_NTH', nth)
+*/
 
-			if goal_freq == 0:
-				best = Meta.Obj(
-					compare_value = 0,
-					clksel        = 0,
-					error         = 0,
-				)
+#include "probe.meta"
+/*
+	#
+	# The probe marker can't be mistaken for text or for a code of the compressor.
+	#
 
-			#
-			# Otherwise, we'll have to bruteforce some options.
-			#
+	assert 0 < PROBE_MARKER < 0x20 and chr(PROBE_MARKER) not in '\t\n\r', \
+		f'Probe marker must be a control character that is not whitespace; got {hex(PROBE_MARKER)}.'
 
-			else:
+	Meta.define('PROBE_MARKER', PROBE_MARKER)
+*/
 
-				for clksel, divider in { # @/pg 110/tbl 15-6/(328P).
-					0b001 : 1,
-					0b010 : 8,
-					0b011 : 64,
-					0b100 : 256,
-					0b101 : 1024,
-				}.items():
+#include "timer_configurer.meta"
+/*
+	#
+	# Ensure each channel is driven by its own timer with its output-compare pin actually set up.
+	#
+
+	assert 1 <= len(SIGNALS) <= 2, \
+		f'Only one or two FSK channels are supported; got {len(SIGNALS)}.'
+
+	for channel in SIGNALS:
+
+		assert channel.timer in TIMERS, \
+			f'Channel {channel.channel} must use one of the timers {list(TIMERS)}; got Timer{channel.timer}.'
 
-					#
-					# Different clock sources results in different frequencies
-					# that the counter will be incremented at. @/pg 110/tbl 15-6/(328P).
-					#
+		assert sum(other.timer == channel.timer for other in SIGNALS) == 1, \
+			f'Channel {channel.channel} shares Timer{channel.timer} with another channel.'
 
-					timer1_freq = F_CLKIO / divider
+		assert any(
+			gpio.kind == 'output_compare' and (gpio.port, gpio.number) == TIMERS[channel.timer].pin
+			for gpio in GPIOS.Transmitter
+		), f'Channel {channel.channel} needs P{''.join(map(str, TIMERS[channel.timer].pin))} to be an output-compare GPIO of the Transmitter.'
 
-					#
-					# Determine the closest compare value that'll output the desired frequency.
-					# Note that division of two must be done since a compare-match only accounts
-					# for half of a cycle.
-					#
+	#
+	# The receivers tell channels apart with band-pass filters, so the tone pairs can't overlap.
+	# We also leave a guard band as wide as the widest frequency shift, and since the timers output
+	# square waves, we also ensure the strong third harmonic of a channel doesn't land in another's band.
+	#
+
+	import itertools
 
-					compare_value = round(timer1_freq / goal_freq / 2 - 1)
+	guard = max(abs(channel.mark - channel.space) for channel in SIGNALS)
 
-					#
-					# Determine the actual frequency that'd be generated and the error from it.
-					#
+	for channel, other in itertools.permutations(SIGNALS, 2):
 
-					calculated_freq = timer1_freq / (compare_value + 1) / 2
-					error           = abs(calculated_freq / goal_freq - 1)
+		other_lo = min(other.mark, other.space) - guard
+		other_hi = max(other.mark, other.space) + guard
 
-					#
-					# The compare value has a limited range of 16 bits, so even if the error is
-					# the best so far, we wouldn't be able to actually use the value anyways.
-					# @/pg 111/sec 15.11.5/(328P).
-					#
+		for tone in (channel.mark, channel.space):
 
-					if 0 <= compare_value <= 2**16-1:
+			assert not (other_lo <= tone <= other_hi), \
+				f'Channel {channel.channel} has a tone of {tone} Hz too close to channel {other.channel} ({other.space} to {other.mark} Hz).'
 
-						# We found a better configuration that minimizes the error?
-						if best is None or error < best.error:
-							best = Meta.Obj(
-								compare_value = compare_value,
-								clksel        = clksel,
-								error         = error,
-							)
+			assert not (other_lo <= tone * 3 <= other_hi), \
+				f'Channel {channel.channel} has a tone of {tone} Hz whose third harmonic lands in channel {other.channel} ({other.space} to {other.mark} Hz).'
 
-			#
-			# Export the values to be used at run-time.
-			#
+	#
+	# Create enumeration of signals that could be sent and channels they could be sent on.
+	#
 
-			Meta.line(f'[Signal_{signal}] = {{ {best.clksel}, {best.compare_value} }}, // {goal_freq} Hz, {best.error * 100 :.4f}% error.')
+	Meta.enums('Signal', None, ('none', 'mark', 'space'))
+	Meta.enums('Channel', None, (channel.channel for channel in SIGNALS))
+	Meta.define('CHANNEL_COUNT', len(SIGNALS))
 */
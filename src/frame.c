@@ -0,0 +1,125 @@
+//
+// Serializes UART data frames into baud symbols, keeping time with the scheduler's ticks.
+//
+// Each baud symbol is due a whole baud period after the previous one was due,
+// rather than after when it actually went out, so lateness doesn't accumulate.
+//
+// With Manchester coding, each baud symbol is sent as two halves: the complement
+// of the bit and then the bit itself, so there's always a transition mid-symbol.
+//
+// The levels of every possible data frame are worked out ahead of time, so each baud
+// symbol (or half of one) takes the same short look-up regardless of what field it's in.
+//
+
+#include "frame_schedule.meta"
+/*
+	#
+	# The levels of each data frame come from the same model the host tooling uses, so the two can't
+	# disagree; bit n of a data frame's schedule is the level of the n-th baud symbol (or half of one)
+	# from the start bit up to the first stop bit, the rest of the stop time being just held.
+	#
+
+	slots = len(frame_symbols(0))
+
+	Meta.define('FRAME_SCHEDULE_SLOTS', slots)
+
+	with Meta.enter(f'static const __flash u8 FRAME_SCHEDULE[{1 << FRAME.data_bits}][{(slots + 7) // 8}] =', '{', '};', indented=True):
+		for data in range(1 << FRAME.data_bits):
+
+			levels = sum(level << slot for slot, (level, periods) in enumerate(frame_symbols(data)))
+
+			Meta.line(f'{{ {', '.join(f'0x{(levels >> shift) & 0xFF :02X}' for shift in range(0, slots, 8))} }}, // 0x{data :02X}.')
+*/
+
+static_assert(FRAME_SCHEDULE_SLOTS == (FRAME_STOP_NTH - FRAME_START_NTH + 1) * (1 + FRAME_MANCHESTER));
+
+struct FrameEncoder
+{
+	u8  baud_nth;    // Zero when idling between data frames.
+	b8  second_half; // Of the Manchester-coded baud symbol.
+	u32 elapsed_us;
+};
+
+static useret u32
+FRAME_symbol_us(struct FrameEncoder* encoder) // How long the current baud symbol lasts.
+{
+	u32 symbol_us = 0;
+
+	#if FRAME_MANCHESTER
+		// Any stop time beyond the first stop bit is just the second half being held longer.
+		if (!encoder->second_half)
+		{
+			symbol_us = BAUD_PERIOD_US / 2;
+		}
+		else
+		{
+			symbol_us = BAUD_PERIOD_US - BAUD_PERIOD_US / 2;
+			if (encoder->baud_nth == FRAME_STOP_NTH)
+			{
+				symbol_us += (u32) (BAUD_PERIOD_US * (FRAME_STOP_BITS - 1));
+			}
+		}
+	#else
+		symbol_us = (encoder->baud_nth == FRAME_STOP_NTH) ? (u32) (BAUD_PERIOD_US * FRAME_STOP_BITS) : BAUD_PERIOD_US;
+	#endif
+
+	return symbol_us;
+}
+
+static useret b8                                             // Time to output the next baud symbol? If idling, a data frame can now begin.
+FRAME_advance(struct FrameEncoder* encoder, u16 delta_ticks)
+{
+	encoder->elapsed_us += (u32) delta_ticks * SCHEDULER_MICROSECONDS_PER_TICK;
+
+	// Idling, so the next data frame can begin whenever.
+	if (!encoder->baud_nth)
+	{
+		encoder->elapsed_us = 0;
+		return true;
+	}
+
+	// Baud symbol is still going?
+	u32 symbol_us = FRAME_symbol_us(encoder);
+
+	if (encoder->elapsed_us < symbol_us)
+	{
+		return false;
+	}
+
+	encoder->elapsed_us -= symbol_us;
+
+	// Onto the second half of the baud symbol.
+	#if FRAME_MANCHESTER
+	if (!encoder->second_half)
+	{
+		encoder->second_half = true;
+	}
+	else
+	#endif
+	// Onto the next baud symbol.
+	{
+		encoder->baud_nth    = (encoder->baud_nth == FRAME_STOP_NTH) ? 0 : encoder->baud_nth + 1;
+		encoder->second_half = false;
+	}
+
+	return true;
+}
+
+static void
+FRAME_begin(struct FrameEncoder* encoder)
+{
+	encoder->baud_nth    = FRAME_START_NTH;
+	encoder->second_half = false;
+}
+
+static useret b8                                       // Mark?
+FRAME_level(struct FrameEncoder* encoder, u8 data) // Level of the current baud symbol for a data frame of the given data bits.
+{
+	#if FRAME_MANCHESTER
+		u8 slot = (encoder->baud_nth - FRAME_START_NTH) * 2 + encoder->second_half;
+	#else
+		u8 slot = encoder->baud_nth - FRAME_START_NTH;
+	#endif
+
+	return (FRAME_SCHEDULE[data & FRAME_DATA_MASK][slot / 8] >> (slot % 8)) & 1;
+}
@@ -0,0 +1,212 @@
+//
+// Each FSK channel's tone is generated by a timer toggling its output-compare pin.
+//
+// Changing a timer's registers whenever would have the new tone begin at a random point of the
+// old tone's period, cutting that half of the square wave short or dragging it out. Instead, the
+// new tone's register images are staged and then applied by the compare-match interrupt, right
+// after the pin toggles and the counter clears, so the new tone begins exactly on an edge.
+//
+
+//
+// In "Clear Timer on Compare Match" mode (CTC), Timer1's counter can be modulated by
+// OCR1A. That is, the counter goes from zero and up but will reset to zero after a
+// compare match to OCR1A, thus never becoming greater than OCR1A (but can be equal to it though).
+// @/pg 97/sec 15.7/(328P).
+// @/pg 109/tbl 15-5/(328P).
+//
+
+#define TIMER1_WAVEFORM_GENERATION_MODE 0b0100
+
+//
+// Configure the OC1A pin to toggle on each compare-match of OCR1A. @/pg 108/sec 15.11.1/(328P).
+//
+
+#define TIMER1_OC1A_MODE 0b01
+
+#define TIMER1_TCCRA                                                    \
+	(                                                                   \
+		(((TIMER1_OC1A_MODE                >> 1) & 1) << COM1A1) |     \
+		(((TIMER1_OC1A_MODE                >> 0) & 1) << COM1A0) |     \
+		(((TIMER1_WAVEFORM_GENERATION_MODE >> 1) & 1) << WGM11 ) |     \
+		(((TIMER1_WAVEFORM_GENERATION_MODE >> 0) & 1) << WGM10 )       \
+	)
+
+#define TIMER1_TCCRB(CLKSEL)                                            \
+	(                                                                   \
+		(((TIMER1_WAVEFORM_GENERATION_MODE >> 2) & 1) << WGM12) |      \
+		((((CLKSEL)                        >> 2) & 1) << CS12 ) |      \
+		((((CLKSEL)                        >> 1) & 1) << CS11 ) |      \
+		((((CLKSEL)                        >> 0) & 1) << CS10 )        \
+	)
+
+#define TIMER1_CLKSEL_MASK ((1 << CS12) | (1 << CS11) | (1 << CS10)) // No clock source means the timer is stopped.
+
+//
+// Timer2 is used in the same way as Timer1, but its counter is only 8 bits wide
+// and it has a different set of clock sources. @/sec 17.7.2/(328P).
+// @/sec 17.11.1/tbl 17-8/(328P).
+//
+
+#define TIMER2_WAVEFORM_GENERATION_MODE 0b010
+
+//
+// Configure the OC2A pin to toggle on each compare-match of OCR2A. @/sec 17.11.1/tbl 17-2/(328P).
+//
+
+#define TIMER2_OC2A_MODE 0b01
+
+#define TIMER2_TCCRA                                                    \
+	(                                                                   \
+		(((TIMER2_OC2A_MODE                >> 1) & 1) << COM2A1) |     \
+		(((TIMER2_OC2A_MODE                >> 0) & 1) << COM2A0) |     \
+		(((TIMER2_WAVEFORM_GENERATION_MODE >> 1) & 1) << WGM21 ) |     \
+		(((TIMER2_WAVEFORM_GENERATION_MODE >> 0) & 1) << WGM20 )       \
+	)
+
+#define TIMER2_TCCRB(CLKSEL)                                            \
+	(                                                                   \
+		(((TIMER2_WAVEFORM_GENERATION_MODE >> 2) & 1) << WGM22) |      \
+		((((CLKSEL)                        >> 2) & 1) << CS22 ) |      \
+		((((CLKSEL)                        >> 1) & 1) << CS21 ) |      \
+		((((CLKSEL)                        >> 0) & 1) << CS20 )        \
+	)
+
+#define TIMER2_CLKSEL_MASK ((1 << CS22) | (1 << CS21) | (1 << CS20))
+
+#include "signal_table.meta"
+/*
+	#
+	# The compare-match interrupt applies the new tone a few dozen cycles after the counter clears;
+	# the counter mustn't have already gone past the new compare value by then, or else the next
+	# compare-match won't happen until the counter overflows.
+	#
+
+	ISR_LATENCY_CYCLES = 64
+
+	for channel in SIGNALS:
+		for goal_freq in (channel.mark, channel.space):
+
+			best = calculate_timer_configuration(channel.timer, goal_freq)
+
+			assert (best.compare_value + 1) * TIMERS[channel.timer].dividers[best.clksel] > ISR_LATENCY_CYCLES, \
+				f'Channel {channel.channel} has a tone of {goal_freq} Hz too high for the tone to be switched on its compare-match.'
+
+	#
+	# Calculate look-up table of the register images that configure each channel's timer to output the desired frequency.
+	#
+
+	with Meta.enter('static const __flash struct { u8 tccrb; u16 ocra; } SIGNAL_TABLE[CHANNEL_COUNT][3] =', '{', '};', indented=True):
+
+		for channel in SIGNALS:
+
+			with Meta.enter(f'[Channel_{channel.channel}] =', '{', '},', indented=True):
+
+				for signal, goal_freq in (('none', 0), ('mark', channel.mark), ('space', channel.space)):
+					best = calculate_timer_configuration(channel.timer, goal_freq)
+					Meta.line(f'[Signal_{signal}] = {{ TIMER{channel.timer}_TCCRB({best.clksel}), {best.compare_value} }}, // {goal_freq} Hz, {best.error * 100 :.4f}% error.')
+*/
+
+//
+// Register images waiting to be applied at the next compare-match.
+//
+
+static volatile struct
+{
+	u8  tccrb;
+	u16 ocra;
+} TIMER1_staged = {0};
+
+static volatile struct
+{
+	u8 tccrb;
+	u8 ocra;
+} TIMER2_staged = {0};
+
+ISR(TIMER1_COMPA_vect) // @/pg 65/tbl 12-6/(328P).
+{
+	// OC1A just toggled and TCNT1 was just cleared, so the new tone's period begins at this edge.
+	OCR1A   = TIMER1_staged.ocra;
+	TCCR1B  = TIMER1_staged.tccrb;
+	TIMSK1 &= ~(1 << OCIE1A);
+}
+
+ISR(TIMER2_COMPA_vect) // @/pg 65/tbl 12-6/(328P).
+{
+	// See TIMER1_COMPA_vect.
+	OCR2A   = TIMER2_staged.ocra;
+	TCCR2B  = TIMER2_staged.tccrb;
+	TIMSK2 &= ~(1 << OCIE2A);
+}
+
+static void
+TIMER1_set_signal(u8 tccrb, u16 ocra)
+{
+	u8 sreg = SREG; // Interrupts might already be disabled, so we'll restore them as they were.
+	cli();
+
+	//
+	// If the timer is stopped or is being stopped, then there's no edge to wait for, so the registers
+	// are written right away; the counter is reset so the tone starts with a whole half-period.
+	//
+
+	if (!(TCCR1B & TIMER1_CLKSEL_MASK) || !(tccrb & TIMER1_CLKSEL_MASK))
+	{
+		TIMSK1 &= ~(1 << OCIE1A);
+		TCCR1A  = TIMER1_TCCRA;
+		TCCR1B  = tccrb;
+		OCR1A   = ocra;
+		TCNT1   = 0;
+	}
+	else
+	{
+		TIMER1_staged.tccrb  = tccrb;
+		TIMER1_staged.ocra   = ocra;
+		TIFR1                = (1 << OCF1A); // A compare-match from before now is mid-period by the time we'd act on it. @/pg 113/sec 15.11.9/(328P).
+		TIMSK1              |= (1 << OCIE1A);
+	}
+
+	SREG = sreg;
+}
+
+static void
+TIMER2_set_signal(u8 tccrb, u8 ocra)
+{
+	u8 sreg = SREG; // See TIMER1_set_signal.
+	cli();
+
+	if (!(TCCR2B & TIMER2_CLKSEL_MASK) || !(tccrb & TIMER2_CLKSEL_MASK))
+	{
+		TIMSK2 &= ~(1 << OCIE2A);
+		TCCR2A  = TIMER2_TCCRA;
+		TCCR2B  = tccrb;
+		OCR2A   = ocra;
+		TCNT2   = 0;
+	}
+	else
+	{
+		TIMER2_staged.tccrb  = tccrb;
+		TIMER2_staged.ocra   = ocra;
+		TIFR2                = (1 << OCF2A); // @/sec 17.11.7/(328P).
+		TIMSK2              |= (1 << OCIE2A);
+	}
+
+	SREG = sreg;
+}
+
+static void
+set_signal(enum Channel channel, enum Signal signal)
+{
+	switch (channel)
+	{
+		#include "set_signal.meta"
+		/*
+			for channel in SIGNALS:
+				Meta.line(f'''
+					case Channel_{channel.channel}:
+					{{
+						TIMER{channel.timer}_set_signal(SIGNAL_TABLE[channel][signal].tccrb, SIGNAL_TABLE[channel][signal].ocra);
+					}} break;
+				''')
+		*/
+	}
+}
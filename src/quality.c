@@ -0,0 +1,189 @@
+//
+// Estimates how much margin a channel has before it starts getting errors.
+//
+//     - Agreement : When a bit is decided, how many samples in the filter's window agreed with the decision.
+//                   A clean signal has every sample agree; as the light gets dimmer or noisier, more samples disagree.
+//     - Jitter    : How far each edge within a data frame is from where the decoder expected a transition to be.
+//                   The eye margin is how much of the half-baud period is left over after the worst edge.
+//     - SNR       : The ratio of agreeing to disagreeing samples, in decibels; it's only meant to be compared against itself.
+//
+// The estimates are over the window since the last report.
+//
+
+struct QualityEstimator
+{
+	u32 bits;
+	u32 agreeing_samples;
+	u32 disagreeing_samples;
+	u16 worst_agreement;        // In permille.
+	u32 edges;
+	u64 squared_error_us_sum;
+	u16 worst_error_us;
+};
+
+static void
+QUALITY_bit(struct QualityEstimator* estimator, u8 agreeing_samples, u8 disagreeing_samples)
+{
+	u16 agreement = (u32) agreeing_samples * 1000 / (agreeing_samples + disagreeing_samples);
+
+	if (!estimator->bits || agreement < estimator->worst_agreement)
+	{
+		estimator->worst_agreement = agreement;
+	}
+
+	estimator->bits                += 1;
+	estimator->agreeing_samples    += agreeing_samples;
+	estimator->disagreeing_samples += disagreeing_samples;
+}
+
+static void
+QUALITY_edge(struct QualityEstimator* estimator, i16 error_us) // Positive for edges that came late.
+{
+	u16 magnitude = error_us < 0 ? -error_us : error_us;
+
+	if (magnitude > estimator->worst_error_us)
+	{
+		estimator->worst_error_us = magnitude;
+	}
+
+	estimator->edges                += 1;
+	estimator->squared_error_us_sum += (u32) magnitude * magnitude;
+}
+
+static useret u16
+QUALITY_sqrt(u32 x) // Rounded down.
+{
+	u32 root = 0;
+
+	for (u32 bit = (u32) 1 << 30; bit; bit >>= 2)
+	{
+		if (x >= root + bit)
+		{
+			x    -= root + bit;
+			root  = (root >> 1) + bit;
+		}
+		else
+		{
+			root >>= 1;
+		}
+	}
+
+	return root;
+}
+
+static useret u16
+QUALITY_log2(u32 x) // In units of 1/256; x must be non-zero.
+{
+	//
+	// The integer part is where the most significant bit is; the fractional bits are
+	// then found one at a time by repeatedly squaring the remaining mantissa.
+	//
+
+	u8 exponent = 0;
+
+	for (u32 y = x; y >= 2; y >>= 1)
+	{
+		exponent += 1;
+	}
+
+	u32 mantissa = exponent > 15 ? x >> (exponent - 15) : x << (15 - exponent); // From 1.0 to 2.0 in 1.15 fixed-point.
+	u8  fraction = 0;
+
+	for (u8 i = 0; i < 8; i += 1)
+	{
+		mantissa   = (mantissa * mantissa) >> 15;
+		fraction <<= 1;
+
+		if (mantissa >= ((u32) 2 << 15))
+		{
+			mantissa >>= 1;
+			fraction  |= 1;
+		}
+	}
+
+	return ((u16) exponent << 8) | fraction;
+}
+
+static void
+QUALITY_report(struct QualityEstimator* estimator, char name)
+{
+	USART0_tx("Quality %c:\n", name);
+
+	//
+	// Per-bit agreement.
+	//
+
+	u32 samples = estimator->agreeing_samples + estimator->disagreeing_samples;
+
+	if (samples)
+	{
+		u32 agreement = estimator->agreeing_samples * 1000 / samples;
+
+		USART0_tx
+		(
+			"\tBits      : %lu, %lu.%lu%% agreement, %u.%u%% worst\n",
+			estimator->bits,
+			agreement / 10,
+			agreement % 10,
+			estimator->worst_agreement / 10,
+			estimator->worst_agreement % 10
+		);
+	}
+	else
+	{
+		USART0_tx("\tBits      : none\n");
+	}
+
+	//
+	// Edge jitter.
+	//
+
+	if (estimator->edges)
+	{
+		u16 rms_us = QUALITY_sqrt(estimator->squared_error_us_sum / estimator->edges);
+		u16 margin = estimator->worst_error_us < BAUD_PERIOD_US / 2
+			? (u32) (BAUD_PERIOD_US / 2 - estimator->worst_error_us) * 1000 / (BAUD_PERIOD_US / 2)
+			: 0;
+
+		USART0_tx
+		(
+			"\tJitter    : %lu edges, %u us RMS, %u us worst\n"
+			"\tEye margin: %u.%u%%\n",
+			estimator->edges,
+			rms_us,
+			estimator->worst_error_us,
+			margin / 10,
+			margin % 10
+		);
+	}
+	else
+	{
+		USART0_tx("\tJitter    : none\n");
+	}
+
+	//
+	// SNR; if not a single sample disagreed, then we can only say it's better than if one did.
+	//
+
+	if (estimator->agreeing_samples)
+	{
+		u32 disagreeing = estimator->disagreeing_samples ? estimator->disagreeing_samples : 1;
+		i32 decibels    = ((i32) QUALITY_log2(estimator->agreeing_samples) - (i32) QUALITY_log2(disagreeing)) * 301 / 2560; // In tenths; 10 * log10(2) = 3.01 dB per doubling.
+		u32 magnitude   = decibels < 0 ? -decibels : decibels;
+
+		USART0_tx_unchecked
+		(
+			"\tSNR       : %S%S%lu.%lu dB\n",
+			estimator->disagreeing_samples ? FSTR("") : FSTR("> "),
+			decibels < 0 ? FSTR("-") : FSTR(""),
+			magnitude / 10,
+			magnitude % 10
+		);
+	}
+	else
+	{
+		USART0_tx("\tSNR       : none\n");
+	}
+
+	*estimator = (struct QualityEstimator) {0};
+}
@@ -0,0 +1,192 @@
+//
+// A cooperative scheduler driven by Timer0's overflow every 128us.
+//
+// Tasks are given in a table from highest to lowest priority. Whenever a task's
+// release time comes, it becomes ready; the highest-priority ready task is run to
+// completion, and then the scheduler looks again from the top. A task that becomes
+// ready again before it got to run has missed its deadline.
+//
+
+#define SCHEDULER_MICROSECONDS_PER_TICK 128
+#define SCHEDULER_TICKS(US)             ((u16) (((US) + SCHEDULER_MICROSECONDS_PER_TICK / 2) / SCHEDULER_MICROSECONDS_PER_TICK))
+
+typedef void SchedulerTaskFunction(u16 delta_ticks); // Ticks since the task last ran.
+
+struct SchedulerTask
+{
+	const __flash char*    name; // Kept in flash since it's only ever printed.
+	SchedulerTaskFunction* function;
+	u16                    period_ticks;
+
+	// Book-keeping.
+	u16 due_tick;
+	u16 prev_tick;
+	u32 runs;
+	u32 misses;
+	u32 busy_subticks;  // Total amount of time spent running, in Timer0 counts of 0.5us.
+	u16 worst_subticks;
+};
+
+static volatile u32 SCHEDULER_ticks = 0;
+
+ISR(TIMER0_OVF_vect) // @/pg 65/tbl 12-6/(328P).
+{
+	SCHEDULER_ticks += 1;
+}
+
+static void
+SCHEDULER_init(void)
+{
+	// Make Timer0 count at a rate of F_CLKIO / 8 = ~16MHz / 8 = ~2 MHz. @/pg 87/tbl 14-9/(328P).
+	// We use the overflow to know when a tick has passed, so 256 / (2 MHz) = 128 us.
+	TCCR0B = (0 << CS02) | (1 << CS01) | (0 << CS00);
+
+	// Interrupt on overflow. @/pg 88/sec 14.9.6/(328P).
+	TIMSK0 = (1 << TOIE0);
+}
+
+static void
+SCHEDULER_timestamp(u32* tick, u8* subtick)
+{
+	u8 sreg = SREG; // Interrupts might already be disabled if we're in an ISR, so we'll restore them as they were.
+	cli();          // The tick counter is multiple bytes wide, so reading it must not be interrupted.
+
+	u32 ticks   = SCHEDULER_ticks;
+	u8  counter = TCNT0;
+
+	// Counter overflowed but the interrupt hasn't been serviced yet? @/pg 88/sec 14.9.7/(328P).
+	if ((TIFR0 & (1 << TOV0)) && counter < 128)
+	{
+		ticks += 1;
+	}
+
+	SREG = sreg;
+
+	*tick    = ticks;
+	*subtick = counter;
+}
+
+static useret u32
+SCHEDULER_now(void) // In ticks.
+{
+	u32 tick    = {0};
+	u8  subtick = {0};
+	SCHEDULER_timestamp(&tick, &subtick);
+	return tick;
+}
+
+static useret u32
+SCHEDULER_subticks(void) // In Timer0 counts of 0.5us; wraps around after ~35 minutes.
+{
+	u32 tick    = {0};
+	u8  subtick = {0};
+	SCHEDULER_timestamp(&tick, &subtick);
+	return (tick << 8) | subtick;
+}
+
+static void
+SCHEDULER_dump(struct SchedulerTask* tasks, u8 task_count)
+{
+	//
+	// Report each task's share of the CPU since the last dump; the counters are then reset.
+	//
+
+	static u32 window_start = 0;
+
+	u32 now     = SCHEDULER_subticks();
+	u32 elapsed = now - window_start;
+
+	window_start = now;
+
+	USART0_tx("Scheduler: %lu ms.\n", elapsed / 2000);
+
+	for (u8 task_i = 0; task_i < task_count; task_i += 1)
+	{
+		struct SchedulerTask* task = &tasks[task_i];
+
+		u32 permille = elapsed ? task->busy_subticks / (elapsed / 1000 + 1) : 0;
+
+		USART0_tx_unchecked
+		(
+			"\t%S : %lu runs, %lu misses, %u us worst, %lu.%lu%% busy\n",
+			task->name,
+			task->runs,
+			task->misses,
+			task->worst_subticks / 2,
+			permille / 10,
+			permille % 10
+		);
+
+		task->runs           = 0;
+		task->misses         = 0;
+		task->busy_subticks  = 0;
+		task->worst_subticks = 0;
+	}
+}
+
+static noret void
+SCHEDULER_run(struct SchedulerTask* tasks, u8 task_count)
+{
+	{
+		u16 now = SCHEDULER_now();
+
+		for (u8 task_i = 0; task_i < task_count; task_i += 1)
+		{
+			tasks[task_i].due_tick  = now;
+			tasks[task_i].prev_tick = now;
+		}
+	}
+
+	for (;;)
+	{
+		for (u8 task_i = 0; task_i < task_count; task_i += 1)
+		{
+			struct SchedulerTask* task = &tasks[task_i];
+
+			u16 now  = SCHEDULER_now();
+			u16 late = now - task->due_tick;
+
+			// Task isn't released yet?
+			if ((i16) late < 0)
+			{
+				continue;
+			}
+
+			//
+			// Schedule the next release. If the task is so late that later releases
+			// have already passed, then those are deadlines that were missed.
+			//
+
+			if (late >= task->period_ticks)
+			{
+				u16 missed      = late / task->period_ticks;
+				task->misses   += missed;
+				task->due_tick += missed * task->period_ticks;
+			}
+
+			task->due_tick += task->period_ticks;
+
+			//
+			// Run the task and account for the time it took.
+			//
+
+			u16 delta_ticks = now - task->prev_tick;
+			task->prev_tick = now;
+
+			u32 start = SCHEDULER_subticks();
+			task->function(delta_ticks);
+			u32 busy  = SCHEDULER_subticks() - start;
+
+			task->runs          += 1;
+			task->busy_subticks += busy;
+
+			if (busy > task->worst_subticks)
+			{
+				task->worst_subticks = busy > 0xFFFF ? 0xFFFF : busy;
+			}
+
+			// Start again from the highest-priority task.
+			break;
+		}
+	}
+}
@@ -140,8 +140,8 @@ STR_show_int(char* dst, u16 dst_size, u64 value, enum StrShowIntStyle style, cha
 	return result;
 }
 
-static void __attribute__((format(printf, 3, 0)))
-STR_fmt_builder_va_list(StrFmtBuilderCallback* callback, void* context, char* fmt, va_list args)
+static void                                                                                                    // Format string can either be in SRAM or flash.
+STR_fmt_builder_va_list(StrFmtBuilderCallback* callback, void* context, const __memx char* fmt, va_list args) // "%S" is for strings in flash.
 {
 	if (callback && fmt)
 	{
@@ -155,27 +155,27 @@ STR_fmt_builder_va_list(StrFmtBuilderCallback* callback, void* context, char* fm
 			} \
 			while (false)
 
-		char* stream = fmt;
+		const __memx char* stream = fmt;
 		while (true)
 		{
 			//
-			// Determine how far we can go before the string ends or there's a format specifier.
+			// Submit the characters up until the string ends or there's a format specifier.
+			// The format string could be in flash, so it's copied over in chunks first.
 			//
 
-			i32 raw_len = 0;
-			while (stream[raw_len] != '\0' && stream[raw_len] != '%')
+			while (stream[0] != '\0' && stream[0] != '%')
 			{
-				raw_len += 1;
-			}
+				char chunk[16] = {0};
+				u8   chunk_len = 0;
 
-			//
-			// There's characters we can submit without any additional processing?
-			//
+				while (chunk_len < countof(chunk) && stream[chunk_len] != '\0' && stream[chunk_len] != '%')
+				{
+					chunk[chunk_len]  = stream[chunk_len];
+					chunk_len        += 1;
+				}
 
-			if (raw_len)
-			{
-				CALLBACK(stream, raw_len);
-				stream += raw_len;
+				CALLBACK(chunk, chunk_len);
+				stream += chunk_len;
 			}
 
 			//
@@ -281,6 +281,34 @@ STR_fmt_builder_va_list(StrFmtBuilderCallback* callback, void* context, char* fm
 						}
 					} break;
 
+					// String in flash; it's copied over in chunks.
+					case 'S':
+					{
+						const __flash char* string = va_arg(args, const __flash char*);
+
+						if (!string)
+						{
+							substr = str("(null)");
+						}
+						else
+						{
+							while (string[0] != '\0')
+							{
+								char chunk[16] = {0};
+								u8   chunk_len = 0;
+
+								while (chunk_len < countof(chunk) && string[chunk_len] != '\0')
+								{
+									chunk[chunk_len]  = string[chunk_len];
+									chunk_len        += 1;
+								}
+
+								CALLBACK(chunk, chunk_len);
+								string += chunk_len;
+							}
+						}
+					} break;
+
 					// Single character.
 					case 'c':
 					{
@@ -337,3 +365,36 @@ STR_fmt_builder(StrFmtBuilderCallback* callback, void* context, char* fmt, ...)
 	STR_fmt_builder_va_list(callback, context, fmt, args);
 	va_end(args);
 }
+
+static void
+STR_fmt_builder_flash(StrFmtBuilderCallback* callback, void* context, const __flash char* fmt, ...)
+{
+	va_list args = {0};
+	va_start(args, fmt);
+	STR_fmt_builder_va_list(callback, context, fmt, args);
+	va_end(args);
+}
+
+//
+// The compiler can't check format strings in flash, so this never-called function
+// is given the same arguments to have them be checked like they would for printf.
+//
+
+static void __attribute__((format(printf, 1, 2)))
+STR_fmt_check(char* fmt, ...)
+{
+}
+
+static useret str          // Copy of the flash string; truncated if there isn't enough space.
+STR_from_fstr(char* dst, u16 dst_size, fstr src)
+{
+	str result = { dst, 0 };
+
+	while (result.len < dst_size && result.len < src.len)
+	{
+		result.data[result.len]  = src.data[result.len];
+		result.len              += 1;
+	}
+
+	return result;
+}
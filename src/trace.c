@@ -0,0 +1,83 @@
+#include "trace.meta"
+/*
+	assert 0 <= TRACE_CAPACITY <= 256 and TRACE_CAPACITY & (TRACE_CAPACITY - 1) == 0, \
+		f'Trace capacity must be zero or a power of two no greater than 256; got {TRACE_CAPACITY}.'
+
+	Meta.define('TRACE_ENABLED' , int(TRACE_CAPACITY != 0))
+	Meta.define('TRACE_CAPACITY', TRACE_CAPACITY           )
+	Meta.enums('TraceEvent', None, TRACE_EVENTS)
+*/
+
+#if TRACE_ENABLED
+
+//
+// Each event is timestamped with the scheduler's 128us tick (truncated to 16 bits) and Timer0's counter within the tick.
+// The ring buffer is overwritten as it goes, so only the most recent events are kept.
+//
+
+struct TraceEntry
+{
+	u16             tick;
+	u8              subtick;
+	u8              channel;
+	enum TraceEvent event;
+	u8              data;
+};
+
+static struct TraceEntry TRACE_ring[TRACE_CAPACITY] = {0};
+static u8                TRACE_writer               = 0; // Free-running; only meaningful modulo TRACE_CAPACITY.
+static u32               TRACE_recorded             = 0; // Total amount of events recorded since the last dump.
+
+#define TRACE(EVENT, CHANNEL, DATA) TRACE_record(TraceEvent_##EVENT, (CHANNEL), (DATA))
+
+static inline void
+TRACE_record(enum TraceEvent event, u8 channel, u8 data)
+{
+	struct TraceEntry* entry = &TRACE_ring[TRACE_writer % TRACE_CAPACITY];
+
+	u32 tick    = {0};
+	u8  subtick = {0};
+	SCHEDULER_timestamp(&tick, &subtick);
+
+	entry->tick     = tick;
+	entry->subtick  = subtick;
+	entry->channel  = channel;
+	entry->event    = event;
+	entry->data     = data;
+	TRACE_writer   += 1;
+	TRACE_recorded += 1;
+}
+
+static void
+TRACE_dump(void)
+{
+	//
+	// Dump oldest to newest; the host will be able to make a timeline out of it.
+	//
+
+	u16 count = TRACE_recorded < TRACE_CAPACITY ? TRACE_recorded : TRACE_CAPACITY;
+
+	USART0_tx("Trace: %u events, %lu dropped.\n", count, TRACE_recorded - count);
+
+	for (u16 i = 0; i < count; i += 1)
+	{
+		struct TraceEntry entry = TRACE_ring[(u8) (TRACE_writer - count + i) % TRACE_CAPACITY];
+		USART0_tx("%u %u %u %u %u\n", entry.tick, entry.subtick, entry.channel, entry.event, entry.data);
+	}
+
+	USART0_tx("Trace end.\n");
+
+	TRACE_recorded = 0;
+}
+
+#else
+
+#define TRACE(EVENT, CHANNEL, DATA) ((void) 0)
+
+static void
+TRACE_dump(void)
+{
+	USART0_tx("Trace: disabled.\n");
+}
+
+#endif
@@ -7,17 +7,42 @@ USART0_init(void)
 
 	#include "USART0_baud_configurer.meta"
 	/*
-		for u2x0, ubrr0 in (
-			(0, F_OSC / (16 * USART0_BAUD) - 1), # Assuming we don't need the U2Xn bit. @/pg 146/tbl 19-1/(328P).
-			(1, F_OSC / (8  * USART0_BAUD) - 1), # Assuming we       need the U2Xn bit. "
+		best = None
+
+		for u2x0, divider in (
+			(0, 16), # Normal speed; preferred since the receiver samples each bit more. @/pg 146/tbl 19-1/(328P).
+			(1, 8 ), # Double speed.                                                      "
 		):
-			# Calculated value fits wthin UBBR0? @/pg 162/sec 19.10.5/(328P).
-			if ubrr0.is_integer() and 0 <= ubrr0 < (1 << 12):
-				Meta.define('USART0_U2X0_init' , u2x0      )
-				Meta.define('USART0_UBBR0_init', int(ubrr0))
-				break
-		else:
-			assert False, f'Desired USART0 baud rate of {USART0_BAUD} is not achievable.'
+			#
+			# Determine the nearest divider value, making sure it fits within UBBR0. @/pg 162/sec 19.10.5/(328P).
+			#
+
+			ubrr0 = min(max(round(F_OSC / (divider * USART0_BAUD) - 1), 0), (1 << 12) - 1)
+
+			#
+			# Determine the actual baud rate that'd be achieved and the error from it.
+			#
+
+			actual = F_OSC / (divider * (ubrr0 + 1))
+			error  = abs(actual / USART0_BAUD - 1)
+
+			# We found a configuration that's strictly better?
+			if best is None or error < best.error:
+				best = Meta.Obj(
+					u2x0   = u2x0,
+					ubrr0  = ubrr0,
+					actual = actual,
+					error  = error,
+				)
+
+		assert best.error <= USART0_BAUD_TOLERANCE, \
+			f'Desired USART0 baud rate of {USART0_BAUD} is not achievable; ' \
+			f'best is {best.actual :.0f} with {best.error * 100 :.2f}% error, ' \
+			f'but the tolerance is {USART0_BAUD_TOLERANCE * 100 :.2f}%.'
+
+		Meta.line(f'// {USART0_BAUD} baud desired; {best.actual :.0f} baud achieved with {best.error * 100 :.2f}% error.')
+		Meta.define('USART0_U2X0_init' , best.u2x0 )
+		Meta.define('USART0_UBBR0_init', best.ubrr0)
 	*/
 
 	//
@@ -43,7 +68,19 @@ USART0_init(void)
 	UCSR0B = (1 << TXEN0) | (1 << RXEN0);
 }
 
-#define USART0_tx(...) STR_fmt_builder(_USART0_tx_callback, 0, __VA_ARGS__)
+#define USART0_tx(FMT, ...) /* The format string is kept in flash; for "%S", use USART0_tx_unchecked since the compiler takes it as a wide string. */ \
+	do \
+	{ \
+		if (false) \
+		{ \
+			STR_fmt_check(FMT, ##__VA_ARGS__); \
+		} \
+		STR_fmt_builder_flash(_USART0_tx_callback, 0, FSTR(FMT), ##__VA_ARGS__); \
+	} \
+	while (false)
+
+#define USART0_tx_unchecked(FMT, ...) /* Same as USART0_tx, but the arguments aren't checked against the format string. */ \
+	STR_fmt_builder_flash(_USART0_tx_callback, 0, FSTR(FMT), ##__VA_ARGS__)
 static enum StrFmtBuilderCallbackResult
 _USART0_tx_callback(void* context, char* data, u16 len)
 {